@@ -0,0 +1,58 @@
+object arraystore {
+  def main(args: Array[String]) {
+    val strings = Array(Array("a", "b"), Array("c"))
+    val objects = new Array[Array[AnyRef]](2)
+    storeOk("arraycopy of Array[Array[String]] to Array[Array[AnyRef]]") {
+      System.arraycopy(strings, 0, objects, 0, 2)
+    }
+
+    val deep = Array(Array(Array("x")))
+    val deepObjects = new Array[Array[Array[AnyRef]]](1)
+    storeOk("arraycopy of Array[Array[Array[String]]] to Array[Array[Array[AnyRef]]]") {
+      System.arraycopy(deep, 0, deepObjects, 0, 1)
+    }
+
+    val rows = new Array[Array[Int]](3)
+    storeOk("Arrays.fill of Array[Array[Int]] with a row") {
+      java.util.Arrays.fill(rows.asInstanceOf[Array[Object]], new Array[Int](4))
+    }
+
+    val ints = new Array[Array[Int]](1)
+    storeExn("arraycopy of Array[Array[String]] to Array[Array[Int]]") {
+      System.arraycopy(strings, 0, ints, 0, 1)
+    }
+    storeExn("Arrays.fill of Array[Array[Int]] with a String") {
+      java.util.Arrays.fill(rows.asInstanceOf[Array[Object]], "row")
+    }
+  }
+
+  def storeOk(what: String)(f: => Unit) {
+    try {
+      f
+      System.out.println("GOOD: " + what)
+    }
+    catch {
+      case e: Exception =>
+        System.out.println("ERROR: " + what + " threw " + e)
+    }
+  }
+
+  def storeExn(what: String)(f: => Unit) {
+    var exn = false
+    try {
+      f
+    }
+    catch {
+      case e: ArrayStoreException =>
+        System.out.println("GOOD: " + what + " threw ArrayStoreException, as expected.")
+        exn = true
+      case e: Exception =>
+        System.out.println("ERROR: " + what + " threw some OTHER exception: " + e)
+        exn = true
+    }
+    finally {
+      if (!exn)
+        System.out.println("ERROR: " + what + " did not throw ArrayStoreException.")
+    }
+  }
+}
@@ -0,0 +1,87 @@
+/* Interface dispatch microbenchmark. Classes mix in 1, 10 and 50 traits
+   and are repeatedly cast from AnyRef to a trait, so every iteration does
+   an interface vtable lookup. T0 is mixed in first and so comes last in
+   each class's interface list, the worst case for a linear search. */
+
+object ifacedispatch {
+  trait T0 { def f0: Int = 0 }
+  trait T1 { def f1: Int = 1 }
+  trait T2 { def f2: Int = 2 }
+  trait T3 { def f3: Int = 3 }
+  trait T4 { def f4: Int = 4 }
+  trait T5 { def f5: Int = 5 }
+  trait T6 { def f6: Int = 6 }
+  trait T7 { def f7: Int = 7 }
+  trait T8 { def f8: Int = 8 }
+  trait T9 { def f9: Int = 9 }
+  trait T10 { def f10: Int = 10 }
+  trait T11 { def f11: Int = 11 }
+  trait T12 { def f12: Int = 12 }
+  trait T13 { def f13: Int = 13 }
+  trait T14 { def f14: Int = 14 }
+  trait T15 { def f15: Int = 15 }
+  trait T16 { def f16: Int = 16 }
+  trait T17 { def f17: Int = 17 }
+  trait T18 { def f18: Int = 18 }
+  trait T19 { def f19: Int = 19 }
+  trait T20 { def f20: Int = 20 }
+  trait T21 { def f21: Int = 21 }
+  trait T22 { def f22: Int = 22 }
+  trait T23 { def f23: Int = 23 }
+  trait T24 { def f24: Int = 24 }
+  trait T25 { def f25: Int = 25 }
+  trait T26 { def f26: Int = 26 }
+  trait T27 { def f27: Int = 27 }
+  trait T28 { def f28: Int = 28 }
+  trait T29 { def f29: Int = 29 }
+  trait T30 { def f30: Int = 30 }
+  trait T31 { def f31: Int = 31 }
+  trait T32 { def f32: Int = 32 }
+  trait T33 { def f33: Int = 33 }
+  trait T34 { def f34: Int = 34 }
+  trait T35 { def f35: Int = 35 }
+  trait T36 { def f36: Int = 36 }
+  trait T37 { def f37: Int = 37 }
+  trait T38 { def f38: Int = 38 }
+  trait T39 { def f39: Int = 39 }
+  trait T40 { def f40: Int = 40 }
+  trait T41 { def f41: Int = 41 }
+  trait T42 { def f42: Int = 42 }
+  trait T43 { def f43: Int = 43 }
+  trait T44 { def f44: Int = 44 }
+  trait T45 { def f45: Int = 45 }
+  trait T46 { def f46: Int = 46 }
+  trait T47 { def f47: Int = 47 }
+  trait T48 { def f48: Int = 48 }
+  trait T49 { def f49: Int = 49 }
+
+  class C1 extends T0
+  class C10 extends T0 with T1 with T2 with T3 with T4 with T5 with T6 with T7 with T8 with T9
+  class C50 extends T0 with T1 with T2 with T3 with T4 with T5 with T6 with T7
+      with T8 with T9 with T10 with T11 with T12 with T13 with T14 with T15
+      with T16 with T17 with T18 with T19 with T20 with T21 with T22 with T23
+      with T24 with T25 with T26 with T27 with T28 with T29 with T30 with T31
+      with T32 with T33 with T34 with T35 with T36 with T37 with T38 with T39
+      with T40 with T41 with T42 with T43 with T44 with T45 with T46 with T47
+      with T48 with T49
+
+  val ITERATIONS = 10000000
+
+  def run(name: String, o: AnyRef) {
+    val start = System.nanoTime()
+    var i = 0
+    var sum = 0
+    while (i < ITERATIONS) {
+      sum += o.asInstanceOf[T0].f0 + 1
+      i += 1
+    }
+    val elapsed = System.nanoTime() - start
+    System.out.println(name + ": " + (elapsed / ITERATIONS) + " ns/call (" + sum + ")")
+  }
+
+  def main(args: Array[String]) {
+    run("1 trait", new C1)
+    run("10 traits", new C10)
+    run("50 traits", new C50)
+  }
+}
@@ -0,0 +1,18 @@
+/* Print throughput benchmark. Writes many short lines mixing literals,
+   concatenated strings and numbers; run with output sent to a file or
+   /dev/null to measure the output path rather than the terminal. */
+
+object printbench {
+  val LINES = 1000000
+
+  def main(args: Array[String]) = {
+    var i = 0
+    while (i < LINES) {
+      System.out.print("line ")
+      System.out.print(i)
+      System.out.println(": the quick brown fox jumps over the lazy dog")
+      i += 1
+    }
+    System.out.flush()
+  }
+}
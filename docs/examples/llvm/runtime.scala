@@ -403,16 +403,23 @@ package java {
     }
     object StandardError extends io.OutputStream {
       @native def write(b: Int): Unit
+      @native override def write(b: Array[Byte], off: Int, len: Int): Unit
+      @native def writeString(s: String): Unit
       @native override def flush(): Unit
+      @native def interactive: Boolean
     }
     object StandardOut extends io.OutputStream {
       @native def write(b: Int): Unit
+      @native override def write(b: Array[Byte], off: Int, len: Int): Unit
+      @native def writeString(s: String): Unit
       @native override def flush(): Unit
+      @native def interactive: Boolean
     }
     object System {
-      // def nanoTime(): Long = 0L
+      @native def nanoTime(): Long
       var err: java.io.PrintStream = new io.PrintStream(StandardError, true)
-      var out: java.io.PrintStream = new io.PrintStream(StandardOut, true)
+      /* only flush every line when someone is watching */
+      var out: java.io.PrintStream = new io.PrintStream(StandardOut, StandardOut.interactive)
       var in: java.io.InputStream = null
       def getProperty(key: String): String = sys.error("getproperty unimplemented")
       def getProperty(key: String, default: String): String = sys.error("getproperty default unimplemented")
@@ -423,100 +430,7 @@ package java {
       def getProperties(): java.util.Properties = sys.error("getproperties unimplemented")
       def clearProperty(key: String): String = sys.error("clearprop unimplemented")
       def setProperty(key: String, value: String): String = sys.error("setprop unimplemented")
-      def arraycopy(src: Object, srcPos: scala.Int, dest: Object, destPos: scala.Int, length: scala.Int): Unit = {
-        (src,dest) match {
-          case (src:Array[Boolean],dest:Array[Boolean]) => {
-            if (srcPos < 0) throw new IndexOutOfBoundsException()
-            if (destPos < 0) throw new IndexOutOfBoundsException()
-            if (length < 0) throw new IndexOutOfBoundsException()
-            if (srcPos+length > src.length) throw new IndexOutOfBoundsException()
-            if (destPos+length > dest.length) throw new IndexOutOfBoundsException()
-            var i = 0
-            while (i < length) {
-              dest(destPos+i) = src(srcPos+i)
-              i = i + 1
-            }
-          }
-          case (src:Array[Char],dest:Array[Char]) => {
-            if (srcPos < 0) throw new IndexOutOfBoundsException()
-            if (destPos < 0) throw new IndexOutOfBoundsException()
-            if (length < 0) throw new IndexOutOfBoundsException()
-            if (srcPos+length > src.length) throw new IndexOutOfBoundsException()
-            if (destPos+length > dest.length) throw new IndexOutOfBoundsException()
-            var i = 0
-            while (i < length) {
-              dest(destPos+i) = src(srcPos+i)
-              i = i + 1
-            }
-          }
-          case (src:Array[Int],dest:Array[Int]) => {
-            if (srcPos < 0) throw new IndexOutOfBoundsException()
-            if (destPos < 0) throw new IndexOutOfBoundsException()
-            if (length < 0) throw new IndexOutOfBoundsException()
-            if (srcPos+length > src.length) throw new IndexOutOfBoundsException()
-            if (destPos+length > dest.length) throw new IndexOutOfBoundsException()
-            var i = 0
-            while (i < length) {
-              dest(destPos+i) = src(srcPos+i)
-              i = i + 1
-            }
-          }
-          case (src:Array[Long],dest:Array[Long]) => {
-            if (srcPos < 0) throw new IndexOutOfBoundsException()
-            if (destPos < 0) throw new IndexOutOfBoundsException()
-            if (length < 0) throw new IndexOutOfBoundsException()
-            if (srcPos+length > src.length) throw new IndexOutOfBoundsException()
-            if (destPos+length > dest.length) throw new IndexOutOfBoundsException()
-            var i = 0
-            while (i < length) {
-              dest(destPos+i) = src(srcPos+i)
-              i = i + 1
-            }
-          }
-          case (src:Array[Float],dest:Array[Float]) => {
-            if (srcPos < 0) throw new IndexOutOfBoundsException()
-            if (destPos < 0) throw new IndexOutOfBoundsException()
-            if (length < 0) throw new IndexOutOfBoundsException()
-            if (srcPos+length > src.length) throw new IndexOutOfBoundsException()
-            if (destPos+length > dest.length) throw new IndexOutOfBoundsException()
-            var i = 0
-            while (i < length) {
-              dest(destPos+i) = src(srcPos+i)
-              i = i + 1
-            }
-          }
-          case (src:Array[Double],dest:Array[Double]) => {
-            if (srcPos < 0) throw new IndexOutOfBoundsException()
-            if (destPos < 0) throw new IndexOutOfBoundsException()
-            if (length < 0) throw new IndexOutOfBoundsException()
-            if (srcPos+length > src.length) throw new IndexOutOfBoundsException()
-            if (destPos+length > dest.length) throw new IndexOutOfBoundsException()
-            var i = 0
-            while (i < length) {
-              dest(destPos+i) = src(srcPos+i)
-              i = i + 1
-            }
-          }
-          case (src:Array[Object],dest:Array[Object]) => {
-            /* FIXME - check that stores are type safe */
-            if (srcPos < 0) throw new IndexOutOfBoundsException()
-            if (destPos < 0) throw new IndexOutOfBoundsException()
-            if (length < 0) throw new IndexOutOfBoundsException()
-            if (srcPos+length > src.length) throw new IndexOutOfBoundsException()
-            if (destPos+length > dest.length) throw new IndexOutOfBoundsException()
-            var i = 0
-            while (i < length) {
-              dest(destPos+i) = src(srcPos+i)
-              i = i + 1
-            }
-          }
-          case _ => {
-            throw new ArrayStoreException()
-          }
-        }
-        val srcArray = if (src.isInstanceOf[Array[_]]) src.asInstanceOf[Array[_]] else throw new ArrayStoreException("source is not an array")
-        val destArray = if (dest.isInstanceOf[Array[_]]) dest.asInstanceOf[Array[_]] else throw new ArrayStoreException("dest is not an array")
-      }
+      @native def arraycopy(src: Object, srcPos: scala.Int, dest: Object, destPos: scala.Int, length: scala.Int): Unit
       def identityHashCode(x: Object): scala.Int = sys.error("identityHashCode unimplemented")
       def gc(): Unit = {}
       @native def debugPointer(o: Object): Unit
@@ -574,6 +488,63 @@ package java {
     trait Comparator[T] {
       def compare(o1: T, o2: T): Int
     }
+    object Arrays {
+      @native def fill(a: Array[scala.Boolean], v: scala.Boolean): Unit
+      @native def fill(a: Array[scala.Boolean], from: scala.Int, to: scala.Int, v: scala.Boolean): Unit
+      @native def equals(a: Array[scala.Boolean], b: Array[scala.Boolean]): scala.Boolean
+      @native def hashCode(a: Array[scala.Boolean]): scala.Int
+      @native def fill(a: Array[scala.Byte], v: scala.Byte): Unit
+      @native def fill(a: Array[scala.Byte], from: scala.Int, to: scala.Int, v: scala.Byte): Unit
+      @native def equals(a: Array[scala.Byte], b: Array[scala.Byte]): scala.Boolean
+      @native def hashCode(a: Array[scala.Byte]): scala.Int
+      @native def fill(a: Array[scala.Short], v: scala.Short): Unit
+      @native def fill(a: Array[scala.Short], from: scala.Int, to: scala.Int, v: scala.Short): Unit
+      @native def equals(a: Array[scala.Short], b: Array[scala.Short]): scala.Boolean
+      @native def hashCode(a: Array[scala.Short]): scala.Int
+      @native def fill(a: Array[scala.Char], v: scala.Char): Unit
+      @native def fill(a: Array[scala.Char], from: scala.Int, to: scala.Int, v: scala.Char): Unit
+      @native def equals(a: Array[scala.Char], b: Array[scala.Char]): scala.Boolean
+      @native def hashCode(a: Array[scala.Char]): scala.Int
+      @native def fill(a: Array[scala.Int], v: scala.Int): Unit
+      @native def fill(a: Array[scala.Int], from: scala.Int, to: scala.Int, v: scala.Int): Unit
+      @native def equals(a: Array[scala.Int], b: Array[scala.Int]): scala.Boolean
+      @native def hashCode(a: Array[scala.Int]): scala.Int
+      @native def fill(a: Array[scala.Long], v: scala.Long): Unit
+      @native def fill(a: Array[scala.Long], from: scala.Int, to: scala.Int, v: scala.Long): Unit
+      @native def equals(a: Array[scala.Long], b: Array[scala.Long]): scala.Boolean
+      @native def hashCode(a: Array[scala.Long]): scala.Int
+      @native def fill(a: Array[scala.Float], v: scala.Float): Unit
+      @native def fill(a: Array[scala.Float], from: scala.Int, to: scala.Int, v: scala.Float): Unit
+      @native def equals(a: Array[scala.Float], b: Array[scala.Float]): scala.Boolean
+      @native def hashCode(a: Array[scala.Float]): scala.Int
+      @native def fill(a: Array[scala.Double], v: scala.Double): Unit
+      @native def fill(a: Array[scala.Double], from: scala.Int, to: scala.Int, v: scala.Double): Unit
+      @native def equals(a: Array[scala.Double], b: Array[scala.Double]): scala.Boolean
+      @native def hashCode(a: Array[scala.Double]): scala.Int
+      @native def fill(a: Array[Object], v: Object): Unit
+      def equals(a: Array[Object], b: Array[Object]): scala.Boolean = {
+        if (a eq b) return true
+        if ((a eq null) || (b eq null) || a.length != b.length) return false
+        var i = 0
+        while (i < a.length) {
+          val x = a(i)
+          if (if (x eq null) b(i) ne null else !x.equals(b(i))) return false
+          i = i + 1
+        }
+        true
+      }
+      def hashCode(a: Array[Object]): scala.Int = {
+        if (a eq null) return 0
+        var h = 1
+        var i = 0
+        while (i < a.length) {
+          val x = a(i)
+          h = 31 * h + (if (x eq null) 0 else x.hashCode)
+          i = i + 1
+        }
+        h
+      }
+    }
   }
   package io {
     trait Serializable
@@ -583,6 +554,61 @@ package java {
     trait Flushable {
       def flush(): Unit
     }
+    class IOException(message: String, cause: Throwable) extends Exception(message, cause) {
+      def this() = this(null, null)
+      def this(message: String) = this(message, null)
+      def this(cause: Throwable) = this(null, cause)
+    }
+    /* Moves byte array ranges straight between array data and a file
+       descriptor. Results are those of the system call, or -errno. */
+    object NativeIO {
+      val READ = 1
+      val WRITE = 2
+      val APPEND = 4
+      val CREATE = 8
+      val TRUNCATE = 16
+      @native def open(path: String, mode: Int): Int
+      @native def close(fd: Int): Int
+      @native def read(fd: Int, b: Array[Byte], off: Int, len: Int): Int
+      @native def write(fd: Int, b: Array[Byte], off: Int, len: Int): Int
+      @native def readv(fd: Int, bufs: Array[Array[Byte]], offs: Array[Int], lens: Array[Int]): Long
+      @native def writev(fd: Int, bufs: Array[Array[Byte]], offs: Array[Int], lens: Array[Int]): Long
+      @native def strerror(err: Int): String
+      def check(r: Int): Int = if (r < 0) throw new IOException(strerror(-r)) else r
+      def check(r: Long): Long = if (r < 0) throw new IOException(strerror(-r.toInt)) else r
+    }
+    abstract class InputStream extends Object with Closeable {
+      def close() {}
+      def read(): Int
+      def read(b: Array[Byte]): Int = read(b, 0, b.length)
+      def read(b: Array[Byte], off: Int, len: Int): Int = {
+        var n = 0
+        var c = 0
+        while (n < len && c >= 0) {
+          c = read()
+          if (c >= 0) {
+            b(off+n) = c.toByte
+            n = n+1
+          }
+        }
+        if (n == 0 && len > 0) -1 else n
+      }
+    }
+    class FileInputStream(fd: Int) extends InputStream {
+      def this(path: String) = this(NativeIO.check(NativeIO.open(path, NativeIO.READ)))
+      override def close() { NativeIO.check(NativeIO.close(fd)) }
+      def read(): Int = {
+        val b = new Array[Byte](1)
+        if (read(b, 0, 1) < 0) -1 else b(0) & 0xff
+      }
+      override def read(b: Array[Byte], off: Int, len: Int): Int = {
+        if (len == 0) 0
+        else {
+          val n = NativeIO.check(NativeIO.read(fd, b, off, len))
+          if (n == 0) -1 else n
+        }
+      }
+    }
     abstract class OutputStream extends Object with Closeable with Flushable {
       def close() {}
       def flush() {}
@@ -603,6 +629,46 @@ package java {
       override def close() = out.close()
       override def flush() = out.flush()
       override def write(b: Int) = out.write(b)
+      override def write(b: Array[Byte], off: Int, len: Int) = out.write(b, off, len)
+    }
+    class FileOutputStream(fd: Int) extends OutputStream {
+      def this(path: String, append: Boolean) = this(NativeIO.check(NativeIO.open(path,
+        NativeIO.WRITE | NativeIO.CREATE | (if (append) NativeIO.APPEND else NativeIO.TRUNCATE))))
+      def this(path: String) = this(path, false)
+      override def close() { NativeIO.check(NativeIO.close(fd)) }
+      def write(b: Int) {
+        val a = new Array[Byte](1)
+        a(0) = b.toByte
+        write(a, 0, 1)
+      }
+      override def write(b: Array[Byte], off: Int, len: Int) {
+        var done = 0
+        while (done < len) {
+          done = done + NativeIO.check(NativeIO.write(fd, b, off+done, len-done))
+        }
+      }
+      /* writes every range, retrying after short writes */
+      def writev(bufs: Array[Array[Byte]], offs: Array[Int], lens: Array[Int]) {
+        var total = 0L
+        var i = 0
+        while (i < lens.length) {
+          total = total + lens(i)
+          i = i+1
+        }
+        val written = NativeIO.check(NativeIO.writev(fd, bufs, offs, lens))
+        if (written < total) {
+          var skip = written
+          i = 0
+          while (i < lens.length) {
+            if (skip >= lens(i)) skip = skip - lens(i)
+            else {
+              write(bufs(i), offs(i) + skip.toInt, lens(i) - skip.toInt)
+              skip = 0
+            }
+            i = i+1
+          }
+        }
+      }
     }
     trait Appendable {
       def append(c: Char): Appendable
@@ -621,6 +687,10 @@ package java {
         _out.write(b)
         if (autoFlush && b == 10) flush()
       }
+      override def write(b: Array[Byte], off: Int, len: Int) = {
+        _out.write(b, off, len)
+        if (autoFlush) flush()
+      }
       def append(c: Char) = this
       def append(csq: CharSequence) = this
       def append(csq: CharSequence, start: Int, end: Int) = this
@@ -635,7 +705,13 @@ package java {
       def print(f: Float): Unit = print(f.toString)
       def print(d: Double): Unit = print(d.toString)
       def print(s: Array[Char]): Unit = print("character array")
-      def print(s: String): Unit = if (s eq null) write(String.utf8bytes("null")) else { write(String.utf8bytes(s)) }
+      def print(s: String): Unit = {
+        val str = if (s eq null) "null" else s
+        /* the standard streams transcode strings straight into their buffers */
+        if (_out eq java.lang.StandardOut) java.lang.StandardOut.writeString(str)
+        else if (_out eq java.lang.StandardError) java.lang.StandardError.writeString(str)
+        else write(String.utf8bytes(str))
+      }
       def print(x: Any): Unit = x match {
         case b: Boolean => print(b)
         case c: Char => print(c)
@@ -932,5 +1008,43 @@ package scala {
     class VolatileShortRef(var elem: scala.Short) extends Object with java.io.Serializable {
       //override def toString() = java.lang.Short.toString(elem)
     }
+    /* A file mapped into memory. The mapping is released by close() or when
+       the buffer is collected. Positions are byte offsets and multi-byte
+       values are in native byte order. */
+    object MappedBuffer {
+      val NORMAL = 0
+      val SEQUENTIAL = 1
+      val RANDOM = 2
+      val WILLNEED = 3
+      val DONTNEED = 4
+      @native private def map(path: String, writable: Boolean): Long
+      def open(path: String, writable: Boolean): MappedBuffer = {
+        val handle = map(path, writable)
+        if (handle < 0) throw new java.io.IOException(path + ": " + java.io.NativeIO.strerror(-handle.toInt))
+        new MappedBuffer(handle)
+      }
+      def open(path: String): MappedBuffer = open(path, false)
+    }
+    final class MappedBuffer private (private[this] val handle: Long) {
+      @native def length: Long
+      @native def close(): Unit
+      @native def advise(advice: Int): Unit
+      @native def get(pos: Long): Byte
+      @native def put(pos: Long, b: Byte): Unit
+      @native def get(pos: Long, dst: Array[Byte], off: Int, len: Int): Unit
+      @native def get(pos: Long, dst: Array[Short], off: Int, len: Int): Unit
+      @native def get(pos: Long, dst: Array[Char], off: Int, len: Int): Unit
+      @native def get(pos: Long, dst: Array[Int], off: Int, len: Int): Unit
+      @native def get(pos: Long, dst: Array[Long], off: Int, len: Int): Unit
+      @native def get(pos: Long, dst: Array[Float], off: Int, len: Int): Unit
+      @native def get(pos: Long, dst: Array[Double], off: Int, len: Int): Unit
+      @native def put(pos: Long, src: Array[Byte], off: Int, len: Int): Unit
+      @native def put(pos: Long, src: Array[Short], off: Int, len: Int): Unit
+      @native def put(pos: Long, src: Array[Char], off: Int, len: Int): Unit
+      @native def put(pos: Long, src: Array[Int], off: Int, len: Int): Unit
+      @native def put(pos: Long, src: Array[Long], off: Int, len: Int): Unit
+      @native def put(pos: Long, src: Array[Float], off: Int, len: Int): Unit
+      @native def put(pos: Long, src: Array[Double], off: Int, len: Int): Unit
+    }
   }
 }
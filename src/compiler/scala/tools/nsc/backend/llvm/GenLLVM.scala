@@ -111,6 +111,9 @@ abstract class GenLLVM extends SubComponent {
 
       lazy val rtVtable = LMInt.i8.pointer.pointer.aliased(".vtable")
 
+      /* DISPLAY_SIZE in klass.h */
+      val displaySize = 8
+
       lazy val rtIfaceInfo =
         new LMStructure(Seq(
           rtClass.pointer,
@@ -127,14 +130,40 @@ abstract class GenLLVM extends SubComponent {
           rtClass.pointer,
           LMInt.i32,
           LMInt.i32,
+          LMInt.i8.pointer, /* itable, filled in by the runtime */
+          LMInt.i8.pointer, /* classobj, filled in by the runtime */
+          LMInt.i32, /* depth */
+          LMInt.i32, /* ifaceid, assigned by the runtime */
+          LMInt.i32, /* eltsize, for arrays */
+          LMInt.i32, /* eltisref, for arrays */
+          new LMArray(displaySize, rtClass.pointer),
           new LMArray(0, rtIfaceInfo)
         )).aliased(".class")
 
+      /* struct icache in runtime.h */
+      lazy val rtIcache: LMStructure with AliasedType =
+        new LMStructure(Seq(
+          LMInt.i32,
+          LMInt.i32,
+          LMInt.i64,
+          LMInt.i64,
+          rtIcache.pointer,
+          LMInt.i8.pointer,
+          new LMArray(4, rtIfaceInfo)
+        )).aliased(".icache")
+
       lazy val rtObject =
         new LMStructure(Seq(
           rtClass.pointer
         )).aliased(".object")
 
+      /* the fields common to all arrays */
+      lazy val rtArrayHeader =
+        new LMStructure(Seq(
+          rtObject,
+          LMInt.i32
+        ))
+
       /* Functions */
 
       lazy val rtNew =
@@ -251,7 +280,7 @@ abstract class GenLLVM extends SubComponent {
 
       def arrayClass(name: String) = new LMGlobalVariable(
         name+"_array", rtClass,
-	Externally_visible, Default, true)
+	Externally_visible, Default, false)
 
       lazy val rtBoolArrayClass = arrayClass("bool")
       lazy val rtByteArrayClass = arrayClass("byte")
@@ -326,9 +355,9 @@ abstract class GenLLVM extends SubComponent {
           Externally_visible, Default, Ccc,
           Seq.empty, Seq.empty, None, None, None)
 
-      lazy val rtMakeString =
+      lazy val rtMakeLiteral =
         new LMFunction(
-          rtObject.pointer, "rt_makestring",
+          rtObject.pointer, "rt_makeliteral",
           Seq(
             ArgSpec(new LocalVariable("s", new LMStructure(Seq(LMInt.i32, LMInt.i8.pointer)).pointer))
           ), false,
@@ -353,6 +382,16 @@ abstract class GenLLVM extends SubComponent {
         Externally_visible, Default, Ccc,
         Seq.empty, Seq.empty, None, None, None)
 
+      lazy val rtIfaceCastCached = new LMFunction(
+        rtVtable, "rt_iface_cast_cached",
+        Seq(
+          ArgSpec(new LocalVariable("obj", rtObject.pointer)),
+          ArgSpec(new LocalVariable("iface", rtClass.pointer)),
+          ArgSpec(new LocalVariable("cache", rtIcache.pointer))
+        ), false,
+        Externally_visible, Default, Ccc,
+        Seq.empty, Seq.empty, None, None, None)
+
       lazy val rtIsinstance = new LMFunction(
         LMInt.i1, "rt_isinstance",
         Seq(
@@ -390,6 +429,10 @@ abstract class GenLLVM extends SubComponent {
         "rt_boxedUnit_vtable", rtVtable,
         Externally_visible, Default, true)
 
+      lazy val rtArrayVtable = new LMGlobalVariable(
+        "rt_vtable_array", rtVtable,
+        Externally_visible, Default, true)
+
       /* Memory Use Intrinsics */
 
       lazy val llvmInvariantTag = new LMStructure(Seq.empty).pointer
@@ -476,6 +519,14 @@ abstract class GenLLVM extends SubComponent {
         Externally_visible, Default, Ccc,
         Seq.empty, Seq.empty, None, None, None)
 
+      lazy val deleteOurException = new LMFunction(
+        LMVoid, "deleteOurException",
+        Seq(
+          ArgSpec(new LocalVariable("e", LMInt.i8.pointer))
+        ), false,
+        Externally_visible, Default, Ccc,
+        Seq.empty, Seq.empty, None, None, None)
+
       lazy val rtAssertNotNull = new LMFunction(
         LMVoid, "rt_assertNotNull",
         Seq(
@@ -493,6 +544,15 @@ abstract class GenLLVM extends SubComponent {
         Externally_visible, Default, Ccc,
         Seq.empty, Seq.empty, None, None, None)
 
+      lazy val rtThrowArrayIndex = new LMFunction(
+        LMVoid, "rt_throwArrayIndex",
+        Seq(
+          ArgSpec(new LocalVariable("a", rtObject.pointer)),
+          ArgSpec(new LocalVariable("i", LMInt.i32))
+        ), false,
+        Externally_visible, Default, Ccc,
+        Seq.empty, Seq.empty, None, None, None)
+
       lazy val rtTypes = Seq(
         definitions.BoxedBooleanClass,
         definitions.BoxedByteClass,
@@ -510,6 +570,7 @@ abstract class GenLLVM extends SubComponent {
         new TypeAlias(rtVtable),
         new TypeAlias(rtClass),
         new TypeAlias(rtIfaceInfo),
+        new TypeAlias(rtIcache),
         new TypeAlias(rtReference),
         scalaPersonality.declare,
         rtNew.declare,
@@ -539,7 +600,7 @@ abstract class GenLLVM extends SubComponent {
         rtUnboxDouble.declare,
         rtUnboxChar.declare,
         rtLoadVtable.declare,
-        rtMakeString.declare,
+        rtMakeLiteral.declare,
         rtBoolArrayClass.declare,
         rtByteArrayClass.declare,
         rtCharArrayClass.declare,
@@ -563,15 +624,19 @@ abstract class GenLLVM extends SubComponent {
         rtIsinstanceIface.declare,
         rtIsinstanceClass.declare,
         rtIfaceCast.declare,
+        rtIfaceCastCached.declare,
         rtBoxedUnit.declare,
         rtBoxedUnitVtable.declare,
+        rtArrayVtable.declare,
         llvmEhException.declare,
         llvmEhSelector.declare,
         rtGetExceptionObject.declare,
         unwindResume.declare,
         unwindRaiseException.declare,
         createOurException.declare,
+        deleteOurException.declare,
         rtAssertArrayBounds.declare,
+        rtThrowArrayIndex.declare,
         rtAssertNotNull.declare,
         llvmInvariantStart.declare,
         llvmInvariantEnd.declare
@@ -675,6 +740,21 @@ abstract class GenLLVM extends SubComponent {
         ))
       }
 
+      /* a fresh inline cache for one interface cast site */
+      def inlineCache(site: String) = {
+        val bytes = (site.getBytes("UTF-8") :+ 0.toByte).map(new CInt(LMInt.i8, _))
+        val sitename = nextconst(new CArray(LMInt.i8, bytes))
+        val cache = nextconst(new CStruct(Seq(
+          new CInt(LMInt.i32, 0),
+          new CInt(LMInt.i32, 0),
+          new CInt(LMInt.i64, 0),
+          new CInt(LMInt.i64, 0),
+          new CNull(rtIcache.pointer),
+          new Cgetelementptr(new CGlobalAddress(sitename), Seq(LMConstant.intconst(0), LMConstant.intconst(0)), LMInt.i8.pointer),
+          new CZeroInit(new LMArray(4, rtIfaceInfo)))))
+        new Cbitcast(new CGlobalAddress(cache), rtIcache.pointer)
+      }
+
       def constValue(c: Constant): LMConstant[_<:ConcreteType] = {
         c.tag match {
           case UnitTag => new CStruct(Seq(new Cbitcast(new CGlobalAddress(rtBoxedUnit), rtObject.pointer), new Cbitcast(new CGlobalAddress(rtBoxedUnitVtable), rtVtable)))
@@ -778,10 +858,11 @@ abstract class GenLLVM extends SubComponent {
 
       def externClass(s: Symbol) = {
         if (c.symbol == s) {
-          new LMGlobalVariable(classInfoName(s), LMOpaque.aliased("thisclass"), Externally_visible, Default, true)
+          new LMGlobalVariable(classInfoName(s), LMOpaque.aliased("thisclass"), Externally_visible, Default, false)
         } else {
+          /* not constant: the runtime caches array classes and itables in them */
           externClasses.getOrElseUpdate(s, {
-            new LMGlobalVariable(classInfoName(s), rtClass, Externally_visible, Default, true)
+            new LMGlobalVariable(classInfoName(s), rtClass, Externally_visible, Default, false)
           })
         }
       }
@@ -869,25 +950,60 @@ abstract class GenLLVM extends SubComponent {
           val tvtableg = new LMGlobalVariable(".vtable."+llvmName(t), tvtable.tpe, Private, Default, true)
           (tvtableg,tvtable)
         }
+        val ancestors = supers.reverse.toList :+ c.symbol
+        val display = ancestors.take(displaySize).map(externClassP) ++
+          Seq.fill((displaySize - ancestors.size) max 0)(new CNull(rtClass.pointer))
         val prefix = if (c.symbol.isModuleClass || c.symbol.isModule) "module " else ""
         val n = stringConstant(prefix+c.symbol.fullName('.'))
+        /* the klass of arrays of this class, as arrayOf in arrays.c would
+         * build it, so the runtime never has to */
+        val refArrayType = new LMStructure(Seq(rtArrayHeader, new LMArray(0, rtReference)))
+        def sizeOf(t: LMType) = new Cptrtoint(new Cgetelementptr(new CNull(t.pointer), Seq[LMConstant[LMInt]](1), t.pointer), LMInt.i32)
+        val thisArrayClass = new LMGlobalVariable(arrayClassInfoName(c.symbol), LMOpaque.aliased("thisarrayclass"), Externally_visible, Default, false)
+        val aci = new CStruct(Seq(stringConstant("["+prefix+c.symbol.fullName('.')),
+                                  new CInt(LMInt.i32, 0),
+                                  externClassP(definitions.ObjectClass),
+                                  new Cbitcast(new CGlobalAddress(rtArrayVtable), rtVtable),
+                                  new CNull(rtClass.pointer),
+                                  externClassP(c.symbol),
+                                  new Cptrtoint(new Cgetelementptr(new CNull(refArrayType.pointer), Seq[LMConstant[LMInt]](0,1), new LMArray(0, rtReference).pointer), LMInt.i32),
+                                  new CInt(LMInt.i32, 0),
+                                  new CNull(LMInt.i8.pointer),
+                                  new CNull(LMInt.i8.pointer),
+                                  new CInt(LMInt.i32, 1),
+                                  new CInt(LMInt.i32, 0),
+                                  sizeOf(rtReference),
+                                  new CInt(LMInt.i32, 1),
+                                  new CArray(rtClass.pointer, Seq(externClassP(definitions.ObjectClass), new Cbitcast(new CGlobalAddress(thisArrayClass), rtClass.pointer)) ++
+                                    Seq.fill(displaySize - 2)(new CNull(rtClass.pointer))),
+                                  new CArray(rtIfaceInfo, Seq.empty)))
+        val acig = new LMGlobalVariable[LMStructure](arrayClassInfoName(c.symbol), aci.tpe, Externally_visible, Default, false)
         val ci = new CStruct(Seq(n,
-                                 new Cptrtoint(new Cgetelementptr(new CNull(ct.pointer), Seq[LMConstant[LMInt]](1), ct.pointer), LMInt.i32),
+                                 sizeOf(ct),
                                  externClassP(c.symbol.superClass),
                                  new Cgetelementptr(classVtableGlobal, Seq[CInt](0,0), rtVtable),
-                                 new CNull(rtClass.pointer),
+                                 new Cbitcast(new CGlobalAddress(acig), rtClass.pointer),
                                  new CNull(rtClass.pointer),
                                  new CInt(LMInt.i32, npointers),
                                  new CInt(LMInt.i32, traitinfo.length),
+                                 new CNull(LMInt.i8.pointer),
+                                 new CNull(LMInt.i8.pointer),
+                                 new CInt(LMInt.i32, ancestors.size - 1),
+                                 new CInt(LMInt.i32, 0),
+                                 new CInt(LMInt.i32, 0),
+                                 new CInt(LMInt.i32, 0),
+                                 new CArray(rtClass.pointer, display),
                                  new CArray(rtIfaceInfo, traits.zip(traitinfo).map{ case (t, (tvg, _)) => new CStruct(Seq(externClassP(t), new Cgetelementptr(new CGlobalAddress(tvg), Seq[CInt](0,0), rtVtable)))})))
-        val cig = new LMGlobalVariable[LMStructure](classInfoName(c.symbol), ci.tpe, Externally_visible, Default, true)
+        val cig = new LMGlobalVariable[LMStructure](classInfoName(c.symbol), ci.tpe, Externally_visible, Default, false)
         val statType = staticsType(c)
         val statics = new LMGlobalVariable[LMStructure](staticsName(c.symbol), statType, Externally_visible, Default, false)
         recordType(statType)
         Seq.concat(
           Seq(
             new TypeAlias(cig.tpe.aliased("thisclass")),
+            new TypeAlias(acig.tpe.aliased("thisarrayclass")),
             cig.define(ci),
+            acig.define(aci),
             classVtableGlobal.define(classVtable),
             statics.define(new CZeroInit(statType))
           ),
@@ -1188,32 +1304,83 @@ abstract class GenLLVM extends SubComponent {
           val selres = nextvar(LMInt.i32)
           val exval = nextvar(rtObject.pointer)
           val handlers = bb.method.exh.filter(_.covers(bb))
+          /* the personality only stops unwinding here for an exception one
+           * of the handlers catches; otherwise the trailing 0 makes this a
+           * cleanup that closes the frame and resumes */
           val header =
             LMBlock(Some(blockExSelLabel(bb, -2)), Seq(
               new call(uwx, llvmEhException, Seq.empty),
-              new call(selres, llvmEhSelector, Seq(
-                uwx, new Cbitcast(new CFunctionAddress(scalaPersonality), LMInt.i8.pointer), externClassP(definitions.ThrowableClass), LMConstant.intconst(0))),
+              new call(selres, llvmEhSelector, Seq[LMValue[_<:ConcreteType]](
+                uwx, new Cbitcast(new CFunctionAddress(scalaPersonality), LMInt.i8.pointer)) ++
+                handlers.map(h => externClassP(h.loadExceptionClass)) ++
+                Seq(LMConstant.intconst(0))),
               new call(exval, rtGetExceptionObject, Seq(uwx)),
               new store(exval, currentException),
               new br(blockExSelLabel(bb, 0))))
-          val hblocks = handlers.zipWithIndex.map { case (h,n) =>
+          /* once a handler is chosen the unwind header goes back to the
+           * runtime's pool; a rethrow from the handler makes a new one */
+          val hblocks = handlers.zipWithIndex.flatMap { case (h,n) =>
             val isinst = nextvar(LMInt.i1)
-            val exi = nextvar(rtObject.pointer)
-            LMBlock(Some(blockExSelLabel(bb,n)), Seq(
-              new call(isinst, rtIsinstance, Seq(exval, externClassP(h.loadExceptionClass))),
-              new br_cond(isinst, blockLabel(h.startBlock), blockExSelLabel(bb, n+1))
-            ))
+            Seq(
+              LMBlock(Some(blockExSelLabel(bb,n)), Seq(
+                new call(isinst, rtIsinstance, Seq(exval, externClassP(h.loadExceptionClass))),
+                new br_cond(isinst, blockExCatchLabel(bb, n), blockExSelLabel(bb, n+1))
+              )),
+              LMBlock(Some(blockExCatchLabel(bb,n)), Seq(
+                new call_void(deleteOurException, Seq(uwx)),
+                new br(blockLabel(h.startBlock))
+              )))
           }
-          val junk = nextvar(LMInt.i32)
           val footer = LMBlock(Some(blockExSelLabel(bb, handlers.length)), Seq(
             new call_void(rtCloseframe, Seq(framepointer)),
-            new call(junk, unwindRaiseException, Seq(uwx)),
+            new call_void(unwindResume, Seq(uwx)),
             unreachable))
           Seq(header) ++ hblocks ++ Seq(footer)
         }
 
+        /* A throw in a block covered by handlers of this method branches
+         * straight to the first handler that catches it, skipping the
+         * system unwinder. Handlers that cannot catch the statically known
+         * class of the exception are left out, and one that must catch it
+         * ends the chain; only an exception none of them catches is raised.
+         */
+        def throwDispatch(bb: BasicBlock, exobj: LMValue[LMPointer], extk: TypeKind): Seq[LMBlock] = {
+          val handlers = bb.method.exh.filter(_.covers(bb))
+          def mustCatch(h: ExceptionHandler) = extk match {
+            case REFERENCE(cls) => cls.isSubClass(h.loadExceptionClass)
+            case _ => false
+          }
+          def cannotCatch(h: ExceptionHandler) = extk match {
+            case REFERENCE(cls) =>
+              val hcls = h.loadExceptionClass
+              !cls.isTrait && !hcls.isTrait && !cls.isSubClass(hcls) && !hcls.isSubClass(cls)
+            case _ => false
+          }
+          val candidates = handlers.filterNot(cannotCatch)
+          val (maybe, rest) = candidates.span(h => !mustCatch(h))
+          val tests = maybe.zipWithIndex.map { case (h,n) =>
+            val isinst = nextvar(LMInt.i1)
+            LMBlock(Some(blockThrowLabel(bb,n)), Seq(
+              new call(isinst, rtIsinstance, Seq(exobj, externClassP(h.loadExceptionClass))),
+              new br_cond(isinst, blockLabel(h.startBlock), blockThrowLabel(bb, n+1))
+            ))
+          }
+          val last = rest.headOption match {
+            case Some(h) =>
+              LMBlock(Some(blockThrowLabel(bb, maybe.length)), Seq(new br(blockLabel(h.startBlock))))
+            case None =>
+              val uwx = nextvar(LMInt.i8.pointer)
+              val junk = nextvar(LMInt.i32)
+              LMBlock(Some(blockThrowLabel(bb, maybe.length)), Seq(
+                new call(uwx, createOurException, Seq(exobj)),
+                new invoke(junk, unwindRaiseException, Seq(uwx), unreachableBlock, blockExSelLabel(bb,-2))))
+          }
+          tests :+ last
+        }
+
         m.code.blocks.filter(reachable).foreach { bb =>
           val stack: mutable.Stack[(LMValue[_<:ConcreteType],TypeKind)] = mutable.Stack()
+          var localThrow: Option[(LMValue[LMPointer],TypeKind)] = None
           def loadobjvtbl(src: LMValue[SomeConcreteType])(implicit _insns: InstBuffer): LMValue[SomeConcreteType] = {
             val asobj = nextvar(rtObject.pointer)
             val clsa = nextvar(rtClass.pointer.pointer)
@@ -1270,6 +1437,24 @@ abstract class GenLLVM extends SubComponent {
           }
           implicit val insns: InstBuffer = new mutable.ListBuffer
           val pass = Label("__PASS__")
+          /* Array indices are compared with the length inline, as one
+           * unsigned compare; only the failing side calls the runtime, from
+           * a block of its own placed after the rest of this block's code. */
+          val coldBlocks = new mutable.ListBuffer[LMBlock]
+          def checkIndex(asobj: LMValue[LMPointer], index: LMValue[_<:ConcreteType])(implicit _insns: InstBuffer) {
+            val asarray = nextvar(rtArrayHeader.pointer)
+            val lengthPtr = nextvar(LMInt.i32.pointer)
+            val length = nextvar(LMInt.i32)
+            val inbounds = nextvar(LMInt.i1)
+            val outofbounds = Label(blockName(bb)+".oob."+coldBlocks.length)
+            _insns.append(new bitcast(asarray, asobj))
+            _insns.append(new getelementptr(lengthPtr, asarray, Seq[CInt](0,1)))
+            _insns.append(new load(length, lengthPtr))
+            _insns.append(new icmp(inbounds, ICond.ult, index.asInstanceOf[LMValue[LMInt]], length))
+            _insns.append(new br_cond(inbounds, pass, outofbounds))
+            coldBlocks.append(LMBlock(Some(outofbounds), Seq(
+              new invoke_void(rtThrowArrayIndex, Seq(asobj, index), unreachableBlock, blockExSelLabel(bb,-2)))))
+          }
           val excpreds = bb.code.blocks.filter(pb => pb.exceptionSuccessors.contains(bb))
           val dirpreds = bb.code.blocks.filter(_.directSuccessors contains bb)
           val preds = (excpreds ++ dirpreds).filter(reachable)
@@ -1305,7 +1490,9 @@ abstract class GenLLVM extends SubComponent {
                     val vtbl = nextvar(rtVtable)
                     val iface1 = nextvar(rtReference)
                     _insns.append(new insertvalue(iface0, new CUndef(rtReference), obj, Seq[LMConstant[LMInt]](0)))
-                    _insns.append(new call(vtbl, rtIfaceCast, Seq(obj, externClassP(targettk.toType.typeSymbol))))
+                    val target = targettk.toType.typeSymbol
+                    val cache = inlineCache(m.symbol.fullName('.') + " as " + target.fullName('.'))
+                    _insns.append(new call(vtbl, rtIfaceCastCached, Seq(obj, externClassP(target), cache)))
                     _insns.append(new insertvalue(iface1, iface0, vtbl, Seq[LMConstant[LMInt]](1)))
                     iface1
               } else if (!targettk.isInterfaceType && !srctk.isInterfaceType) {
@@ -1435,8 +1622,8 @@ abstract class GenLLVM extends SubComponent {
                 val value = constValue(const)
                 if (const.tag == StringTag) {
                     val g = nextconst(value)
-                    val v = nextvar(rtMakeString.resultType)
-                    insns.append(new call(v, rtMakeString, Seq(new CGlobalAddress(g))))
+                    val v = nextvar(rtMakeLiteral.resultType)
+                    insns.append(new call(v, rtMakeLiteral, Seq(new CGlobalAddress(g))))
                     push((getptrref(v),toTypeKind(const.tpe)))
                 } else {
                   push((value,toTypeKind(const.tpe)))
@@ -1457,8 +1644,7 @@ abstract class GenLLVM extends SubComponent {
                 val item = nextvar(typeKindType(kind))
                 val asobj = getrefptr(array)
                 insns.append(new invoke_void(rtAssertNotNull, Seq(asobj), pass, blockExSelLabel(bb,-2)))
-                insns.append(new invoke_void(rtAssertArrayBounds, Seq(asobj, index),
-                                             pass, blockExSelLabel(bb,-2)))
+                checkIndex(asobj, index)
                 insns.append(new getelementptr(classPtrPtr, asobj, Seq[CInt](0,0)))
                 insns.append(new load(classPtr, classPtrPtr))
                 insns.append(new getelementptr(eltsOffsetPtr, classPtr, Seq[CInt](0,6)))
@@ -1547,8 +1733,7 @@ abstract class GenLLVM extends SubComponent {
                 val itemptr = nextvar(typeKindType(kind).pointer)
                 val asobj = getrefptr(array)
                 insns.append(new invoke_void(rtAssertNotNull, Seq(asobj), pass, blockExSelLabel(bb,-2)))
-                insns.append(new invoke_void(rtAssertArrayBounds, Seq(asobj, index),
-                                             pass, blockExSelLabel(bb,-2)))
+                checkIndex(asobj, index)
                 insns.append(new getelementptr(classPtrPtr, asobj, Seq[CInt](0,0)))
                 insns.append(new load(classPtr, classPtrPtr))
                 insns.append(new getelementptr(eltsOffsetPtr, classPtr, Seq[CInt](0,6)))
@@ -2034,10 +2219,18 @@ abstract class GenLLVM extends SubComponent {
               }
               case THROW(_) => {
                 val (exception,esym) = pop()
-                val uwx = nextvar(LMInt.i8.pointer)
-                val junk = nextvar(LMInt.i32)
-                insns.append(new call(uwx, createOurException, Seq(getrefptr(exception))))
-                insns.append(new invoke(junk, unwindRaiseException, Seq(uwx), unreachableBlock, blockExSelLabel(bb,-2)))
+                val exobj = getrefptr(exception)
+                if (bb.method.exh.exists(_.covers(bb))) {
+                  insns.append(new invoke_void(rtAssertNotNull, Seq(exobj), pass, blockExSelLabel(bb,-2)))
+                  insns.append(new store(exobj, currentException))
+                  insns.append(new br(blockThrowLabel(bb,0)))
+                  localThrow = Some((exobj, esym))
+                } else {
+                  val uwx = nextvar(LMInt.i8.pointer)
+                  val junk = nextvar(LMInt.i32)
+                  insns.append(new call(uwx, createOurException, Seq(exobj)))
+                  insns.append(new invoke(junk, unwindRaiseException, Seq(uwx), unreachableBlock, blockExSelLabel(bb,-2)))
+                }
               }
               case DROP(kind) => pop()
               case DUP(kind) => push(stack.top)
@@ -2139,6 +2332,11 @@ abstract class GenLLVM extends SubComponent {
               blocks.append(LMBlock(Some(blockLabel(bb,blocknum)), curblockinsns.toList))
               curblockinsns.clear()
               blocknum += 1
+            case bc: br_cond if bc.l1 eq pass =>
+              curblockinsns.append(new br_cond(bc.cond, blockLabel(bb,blocknum+1), bc.l2))
+              blocks.append(LMBlock(Some(blockLabel(bb,blocknum)), curblockinsns.toList))
+              curblockinsns.clear()
+              blocknum += 1
             case i if i eq terminator =>
               curblockinsns.append(new br(blockLabel(bb,-1)))
               blocks.append(LMBlock(Some(blockLabel(bb,blocknum)), curblockinsns.toList))
@@ -2148,6 +2346,8 @@ abstract class GenLLVM extends SubComponent {
               curblockinsns.append(i)
           }
           blocks ++= exSels(bb)
+          blocks ++= coldBlocks
+          localThrow.foreach { case (exobj, extk) => blocks ++= throwDispatch(bb, exobj, extk) }
         }
 
         val allocaLocals = m.locals.map(l => new alloca(localCell(l), typeKindType(l.kind)))
@@ -2429,6 +2629,10 @@ abstract class GenLLVM extends SubComponent {
     def blockName(bb: BasicBlock, x: Int) = "bb."+bb.label+"."+x.toString
     def blockExSelName(bb: BasicBlock, x: Int) = "bb."+bb.label+".exh."+x.toString
     def blockExSelLabel(bb: BasicBlock, x: Int) = Label(blockExSelName(bb, x))
+    def blockExCatchName(bb: BasicBlock, x: Int) = "bb."+bb.label+".catch."+x.toString
+    def blockExCatchLabel(bb: BasicBlock, x: Int) = Label(blockExCatchName(bb, x))
+    def blockThrowName(bb: BasicBlock, x: Int) = "bb."+bb.label+".throw."+x.toString
+    def blockThrowLabel(bb: BasicBlock, x: Int) = Label(blockThrowName(bb, x))
 
     def privateClassInfoName(s: Symbol) = {
       "priv_classinfo_"+llvmName(s)
@@ -2438,6 +2642,10 @@ abstract class GenLLVM extends SubComponent {
       "class_"+llvmName(s)
     }
 
+    def arrayClassInfoName(s: Symbol) = {
+      classInfoName(s)+"_array"
+    }
+
     def staticsName(s: Symbol) = {
       "statics_"+llvmName(s)
     }
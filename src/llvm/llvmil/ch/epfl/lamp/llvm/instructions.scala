@@ -42,7 +42,7 @@ object ret {
   def apply(v: LMValue[_ <: ConcreteType]) = new ret(v)
   def void = retvoid
 }
-class br_cond(cond: LMValue[LMInt], l1: Label, l2: Label) extends Instruction {
+class br_cond(val cond: LMValue[LMInt], val l1: Label, val l2: Label) extends Instruction {
   //require(cond.tpe == LMInt.i1)
   def syntax = "br "+cond.tperep+", "+l1.tperep+", "+l2.tperep
 }
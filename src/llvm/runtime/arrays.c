@@ -8,7 +8,7 @@
 
 #include "gc.h"
 
-static void *vtable_array[] = {
+void *rt_vtable_array[] = {
   method_java_Dlang_DObject_Mclone_Rjava_Dlang_DObject,
   method_java_Dlang_DObject_Mequals_Ajava_Dlang_DObject_Rscala_DBoolean,
   method_java_Dlang_DObject_Mfinalize_Rscala_DUnit,
@@ -16,27 +16,55 @@ static void *vtable_array[] = {
   method_java_Dlang_DObject_MtoString_Rjava_Dlang_DString,
 };
 
+/* Array Klasses
+ *
+ * A klass's array klass hangs off its arrayklass field. The compiler emits
+ * the array klass of every class it compiles along with the class, and the
+ * runtime defines those of the primitives and of its own classes, so
+ * arrayOf only builds klasses for arrays of arrays. It publishes them with
+ * a compare and swap; a thread that loses the race frees its copy and uses
+ * the winner's. */
+
+static struct klass *
+newarrayklass(struct klass *klass)
+{
+  /* the name is allocated along with the klass */
+  struct klass *ac = calloc(1, sizeof(struct klass) + klass->name.len + 1);
+  ac->name.len = klass->name.len+1;
+  ac->name.bytes = (char*)(ac+1);
+  ac->name.bytes[0] = '[';
+  memcpy(&ac->name.bytes[1], klass->name.bytes, klass->name.len);
+  ac->instsize = 0;
+  ac->super = &class_java_Dlang_DObject;
+  ac->vtable = rt_vtable_array;
+  ac->eltsoffset = offsetof(struct { struct array head; struct reference data[]; }, data);
+  ac->numiface = 0;
+  ac->itable = NULL;
+  ac->depth = 1;
+  ac->eltsize = sizeof(struct reference);
+  ac->eltisref = 1;
+  ac->display[0] = &class_java_Dlang_DObject;
+  ac->display[1] = ac;
+  ac->arrayklass = NULL;
+  ac->elementklass = klass;
+  return ac;
+}
+
 struct klass *arrayOf(struct klass *klass)
 {
-  if (klass->arrayklass == NULL) {
-    struct klass *ac = malloc(sizeof(struct klass));
-    ac->name.len = klass->name.len+1;
-    ac->name.bytes = malloc(klass->name.len+1);
-    ac->name.bytes[0] = '[';
-    memcpy(&ac->name.bytes[1], klass->name.bytes, klass->name.len);
-    ac->instsize = 0;
-    ac->super = &class_java_Dlang_DObject;
-    ac->vtable = vtable_array;
-    ac->eltsoffset = offsetof(struct { struct array head; struct reference data[]; }, data);
-    ac->numiface = 0;
-    ac->arrayklass = NULL;
-    ac->elementklass = klass;
-    klass->arrayklass = ac;
+  struct klass *ac = klass->arrayklass;
+  if (ac == NULL) {
+    ac = newarrayklass(klass);
+    if (!__sync_bool_compare_and_swap(&klass->arrayklass, NULL, ac)) {
+      free(ac);
+      ac = klass->arrayklass;
+    }
   }
-  return klass->arrayklass;
+  return ac;
 }
 
-#define PRIM_ARRAY(t,ctype) struct klass t ## _array = { { sizeof("[" # t)-1, "[" # t }, 0, &class_java_Dlang_DObject, vtable_array, NULL, NULL, offsetof(struct { struct array head; ctype data[]; }, data), 0 }
+#define PRIM_ARRAY(t,ctype) struct klass t ## _array = { { sizeof("[" # t)-1, "[" # t }, 0, &class_java_Dlang_DObject, rt_vtable_array, NULL, NULL, offsetof(struct { struct array head; ctype data[]; }, data), 0, NULL, NULL, 1, 0, sizeof(ctype), 0, { &class_java_Dlang_DObject, &t ## _array } }
+#define REF_ARRAY(c,n) struct klass c ## _array = { { sizeof("[" n)-1, "[" n }, 0, &class_java_Dlang_DObject, rt_vtable_array, NULL, &c, offsetof(struct { struct array head; struct reference data[]; }, data), 0, NULL, NULL, 1, 0, sizeof(struct reference), 1, { &class_java_Dlang_DObject, &c ## _array } }
 
 PRIM_ARRAY(bool, bool);
 PRIM_ARRAY(byte, int8_t);
@@ -47,17 +75,35 @@ PRIM_ARRAY(long, int64_t);
 PRIM_ARRAY(float, float);
 PRIM_ARRAY(double, double);
 
+extern struct klass class_java_Dlang_DString;
+
+REF_ARRAY(class_java_Dlang_DObject, "java.lang.Object");
+REF_ARRAY(class_java_Dlang_DString, "java.lang.String");
+
 #undef PRIM_ARRAY
+#undef REF_ARRAY
+
+/* With CONTIGUOUS_ARRAYS every level of a multi-dimensional array below
+ * CONTIGUOUS_ARRAY_LIMIT bytes is carved from one heap block, breadth first,
+ * so the rows of the innermost level follow one another in memory. */
+#ifndef CONTIGUOUS_ARRAYS
+#define CONTIGUOUS_ARRAYS 1
+#endif
+
+#ifndef CONTIGUOUS_ARRAY_LIMIT
+#define CONTIGUOUS_ARRAY_LIMIT (256L*1024L*1024L)
+#endif
 
 struct array *
-allocate_array(struct klass **aclasses, int32_t *dims, int32_t ndims, size_t eltsize);
+allocate_array(struct klass **aclasses, int32_t *dims, int32_t ndims);
+struct array *
+allocate_contiguous(struct klass **aclasses, int32_t *dims, int32_t ndims);
 
 struct array *
 new_array(uint8_t k, struct klass *et, int32_t ndims, int32_t dim0, ...)
 {
   va_list vdims;
   struct klass *aclass;
-  size_t eltsize;
   struct array *a;
   void *data;
   size_t datasize;
@@ -74,39 +120,30 @@ new_array(uint8_t k, struct klass *et, int32_t ndims, int32_t dim0, ...)
   switch (k) {
     case BOOL:
       aclass = &bool_array;
-      eltsize = sizeof(bool);
       break;
     case BYTE:
       aclass = &byte_array;
-      eltsize = sizeof(int8_t);
       break;
     case SHORT:
       aclass = &short_array;
-      eltsize = sizeof(int16_t);
       break;
     case CHAR:
       aclass = &char_array;
-      eltsize = sizeof(uint16_t);
       break;
     case INT:
       aclass = &int_array;
-      eltsize = sizeof(int32_t);
       break;
     case LONG:
       aclass = &long_array;
-      eltsize = sizeof(int64_t);
       break;
     case FLOAT:
       aclass = &float_array;
-      eltsize = sizeof(float);
       break;
     case DOUBLE:
       aclass = &double_array;
-      eltsize = sizeof(double);
       break;
     case OBJECT:
       aclass = arrayOf(et);
-      eltsize = sizeof(struct reference);
       break;
   }
   struct klass *aclasses[ndims];
@@ -115,24 +152,81 @@ new_array(uint8_t k, struct klass *et, int32_t ndims, int32_t dim0, ...)
     aclasses[ndims-i] = arrayOf(aclasses[(ndims-i)+1]);
   }
 
-  return allocate_array(aclasses, dims, ndims, eltsize);
+#if CONTIGUOUS_ARRAYS
+  if (ndims > 1) {
+    a = allocate_contiguous(aclasses, dims, ndims);
+    if (a != NULL) return a;
+  }
+#endif
+  return allocate_array(aclasses, dims, ndims);
+}
+
+static size_t
+levelsize(struct klass **aclasses, int32_t *dims, int32_t level)
+{
+  return aclasses[level]->eltsoffset + (size_t)dims[level] * aclasses[level]->eltsize;
+}
+
+/* Returns NULL when the array is too large for one block. */
+struct array *
+allocate_contiguous(struct klass **aclasses, int32_t *dims, int32_t ndims)
+{
+  size_t count = 1;
+  size_t interiorbytes = 0;
+  for (int32_t l = 1; l < ndims; ++l) {
+    count *= dims[l-1];
+    if (count > CONTIGUOUS_ARRAY_LIMIT) return NULL;
+    interiorbytes += count * rt_interiorsize(levelsize(aclasses, dims, l));
+    if (interiorbytes > CONTIGUOUS_ARRAY_LIMIT) return NULL;
+  }
+
+  char *cursor;
+  struct array *me = (struct array*)gcalloc_block(levelsize(aclasses, dims, 0), interiorbytes, &cursor);
+  me->length = dims[0];
+  me->super.klass = aclasses[0];
+
+  /* the arrays of each level follow those of the level above, in order */
+  struct array *parents = me;
+  size_t nparents = 1;
+  size_t stride = 0;
+  for (int32_t l = 1; l < ndims; ++l) {
+    size_t size = levelsize(aclasses, dims, l);
+    struct array *first = NULL;
+    for (size_t p = 0; p < nparents; ++p) {
+      struct array *parent = (struct array*)(((char*)parents) + p*stride);
+      struct reference *data = ARRAY_DATA(parent, struct reference);
+      for (int32_t i = 0; i < dims[l-1]; ++i) {
+        struct array *row = (struct array*)gcalloc_interior((struct java_lang_Object*)me, &cursor, size);
+        row->length = dims[l];
+        row->super.klass = aclasses[l];
+        data[i].vtable = aclasses[l]->vtable;
+        data[i].object = (struct java_lang_Object*)row;
+        if (first == NULL) first = row;
+      }
+    }
+    if (first == NULL) break;
+    parents = first;
+    nparents *= dims[l-1];
+    stride = rt_interiorsize(size);
+  }
+  return me;
 }
 
 struct array *
-allocate_array(struct klass **aclasses, int32_t *dims, int32_t ndims, size_t eltsize)
+allocate_array(struct klass **aclasses, int32_t *dims, int32_t ndims)
 {
   int32_t mydim = dims[0];
   struct klass *myclass = aclasses[0];
   size_t datasize;
   if (ndims == 1) {
-    datasize = myclass->eltsoffset + mydim * eltsize;
+    datasize = myclass->eltsoffset + mydim * myclass->eltsize;
     struct array *me = (struct array*)gcalloc(datasize);
     me->length = mydim;
     me->super.klass = myclass;
     return me;
   } else {
     void *gcfp = rt_openframe();
-    datasize = myclass->eltsoffset + mydim * sizeof(struct reference);
+    datasize = myclass->eltsoffset + mydim * myclass->eltsize;
     struct array *me = (struct array*)gcalloc(datasize);
     me->length = mydim;
     me->super.klass = myclass;
@@ -140,7 +234,7 @@ allocate_array(struct klass **aclasses, int32_t *dims, int32_t ndims, size_t elt
     struct reference *mydata = ARRAY_DATA(me, struct reference);
     for (int i = 0; i < mydim; ++i) {
       mydata[i].vtable = aclasses[1]->vtable;
-      mydata[i].object = (struct java_lang_Object*)allocate_array(aclasses + 1, dims + 1, ndims - 1, eltsize);
+      mydata[i].object = (struct java_lang_Object*)allocate_array(aclasses + 1, dims + 1, ndims - 1);
     }
     rt_closeframe(gcfp);
     return me;
@@ -153,14 +247,238 @@ extern void
 method_java_Dlang_DArrayIndexOutOfBoundsException_M_Linit_G_Rjava_Dlang_DArrayIndexOutOfBoundsException(
     struct java_lang_Object *, vtable_t);
 
+void rt_throwArrayIndex(struct array *arr,
+                        int32_t i)
+{
+  static struct java_lang_Object *aioobe = NULL;
+  rt_throw_preallocated(&aioobe, &class_java_Dlang_DArrayIndexOutOfBoundsException,
+      method_java_Dlang_DArrayIndexOutOfBoundsException_M_Linit_G_Rjava_Dlang_DArrayIndexOutOfBoundsException);
+}
+
 void rt_assertArrayBounds(struct array *arr,
                           int32_t i)
 {
-  if(i < 0 || i >= arr->length) {
-    struct java_lang_Object *exception = rt_new(&class_java_Dlang_DArrayIndexOutOfBoundsException);
-    void *uwx;
-    method_java_Dlang_DArrayIndexOutOfBoundsException_M_Linit_G_Rjava_Dlang_DArrayIndexOutOfBoundsException(exception, rt_loadvtable(exception));
-    uwx = createOurException(exception);
-    _Unwind_RaiseException(uwx);
+  rt_checkArrayIndex(arr, i);
+}
+
+/* Checks once that every index in [lo, hi) is valid, so a loop over that
+ * range needs no per-element check. */
+void rt_assertArrayRange(struct array *arr,
+                         int32_t lo,
+                         int32_t hi)
+{
+  if (lo < 0) rt_throwArrayIndex(arr, lo);
+  if (hi > arr->length) rt_throwArrayIndex(arr, hi);
+  if (hi < lo) rt_throwArrayIndex(arr, hi);
+}
+
+/* Bulk Operations
+ *
+ * System.arraycopy and the java.util.Arrays natives work on whole ranges of
+ * ARRAY_DATA: copies are memmove, so overlapping ranges of one array behave
+ * as if copied through a temporary, and fills and compares are simple loops
+ * over the element type that the compiler vectorizes. Reference stores made
+ * in bulk are reported to the collector with rt_arraystore_barrier. */
+
+extern struct klass class_java_Dlang_DArrayStoreException;
+extern struct klass class_java_Dlang_DIllegalArgumentException;
+
+extern void
+method_java_Dlang_DArrayStoreException_M_Linit_G_Rjava_Dlang_DArrayStoreException(
+    struct java_lang_Object *, vtable_t);
+extern void
+method_java_Dlang_DIllegalArgumentException_M_Linit_G_Rjava_Dlang_DIllegalArgumentException(
+    struct java_lang_Object *, vtable_t);
+
+static inline bool
+isarray(struct java_lang_Object *obj)
+{
+  return obj->klass->eltsize != 0;
+}
+
+/* whether obj may be stored in an array with elements of klass elt. Array
+ * klasses have instsize 0 like interfaces but no itable bits, so they are
+ * checked as classes. */
+static inline bool
+storable(struct java_lang_Object *obj, struct klass *elt)
+{
+  return elt->eltsize != 0 ? rt_isinstance_class(obj, elt) : rt_isinstance(obj, elt);
+}
+
+static void
+throwarraystore()
+{
+  rt_throw_new(&class_java_Dlang_DArrayStoreException,
+      method_java_Dlang_DArrayStoreException_M_Linit_G_Rjava_Dlang_DArrayStoreException);
+}
+
+/* checks that [from, to) lies within arr */
+static void
+checkrange(struct array *arr, int32_t from, int32_t to)
+{
+  if (from > to) {
+    rt_throw_new(&class_java_Dlang_DIllegalArgumentException,
+        method_java_Dlang_DIllegalArgumentException_M_Linit_G_Rjava_Dlang_DIllegalArgumentException);
+  }
+  rt_assertArrayRange(arr, from, to);
+}
+
+void
+method__Ojava_Dlang_DSystem_Marraycopy_Ajava_Dlang_DObject_Ascala_DInt_Ajava_Dlang_DObject_Ascala_DInt_Ascala_DInt_Rscala_DUnit(
+    struct java_lang_Object *self, vtable_t selfVtable,
+    struct java_lang_Object *srcobj, vtable_t srcVtable, int32_t srcPos,
+    struct java_lang_Object *destobj, vtable_t destVtable, int32_t destPos,
+    int32_t length)
+{
+  struct array *src = (struct array*)srcobj;
+  struct array *dest = (struct array*)destobj;
+  rt_assertNotNull(srcobj);
+  rt_assertNotNull(destobj);
+  if (!isarray(srcobj) || !isarray(destobj)) throwarraystore();
+  struct klass *sk = srcobj->klass;
+  struct klass *dk = destobj->klass;
+  bool refs = dk->eltisref;
+  if (refs != sk->eltisref || (!refs && sk != dk)) throwarraystore();
+  if (length < 0) rt_assertArrayBounds(dest, length);
+  if (srcPos < 0 || (int64_t)srcPos + length > src->length) {
+    rt_assertArrayBounds(src, srcPos < 0 ? srcPos : src->length);
+  }
+  if (destPos < 0 || (int64_t)destPos + length > dest->length) {
+    rt_assertArrayBounds(dest, destPos < 0 ? destPos : dest->length);
+  }
+  if (length == 0) return;
+  if (!refs) {
+    size_t eltsize = dk->eltsize;
+    memmove((char*)ARRAY_DATA(dest, char) + destPos * eltsize,
+            (char*)ARRAY_DATA(src, char) + srcPos * eltsize,
+            length * eltsize);
+    return;
   }
+  struct reference *to = ARRAY_DATA(dest, struct reference) + destPos;
+  struct reference *from = ARRAY_DATA(src, struct reference) + srcPos;
+  if (sk == dk || rt_issubclass(dk, sk)) {
+    memmove(to, from, length * sizeof(struct reference));
+    rt_arraystore_barrier(destobj, to, length);
+    return;
+  }
+  /* every element must be checked; elements before a bad one are copied.
+   * The arrays differ, so the ranges cannot overlap. */
+  struct klass *elt = dk->elementklass;
+  for (int32_t i = 0; i < length; i++) {
+    if (from[i].object != NULL && !storable(from[i].object, elt)) {
+      rt_arraystore_barrier(destobj, to, i);
+      throwarraystore();
+    }
+    to[i] = from[i];
+  }
+  rt_arraystore_barrier(destobj, to, length);
+}
+
+/* Java compares and hashes floating point elements by their bits, with all
+ * NaNs alike */
+static inline int32_t
+floatbits(float f)
+{
+  union { float f; int32_t i; } u;
+  if (f != f) return 0x7fc00000;
+  u.f = f;
+  return u.i;
+}
+
+static inline int64_t
+doublebits(double d)
+{
+  union { double d; int64_t l; } u;
+  if (d != d) return INT64_C(0x7ff8000000000000);
+  u.d = d;
+  return u.l;
+}
+
+#define SAME_BITS(a,b) ((a) == (b))
+#define SAME_FLOAT(a,b) (floatbits(a) == floatbits(b))
+#define SAME_DOUBLE(a,b) (doublebits(a) == doublebits(b))
+
+#define HASH_INT(v) ((int32_t)(v))
+#define HASH_BOOL(v) ((v) ? 1231 : 1237)
+#define HASH_LONG(v) ((int32_t)((v) ^ (int64_t)((uint64_t)(v) >> 32)))
+#define HASH_FLOAT(v) floatbits(v)
+#define HASH_DOUBLE(v) HASH_LONG(doublebits(v))
+
+/* fill(a, v), fill(a, from, to, v), equals(a, b) and hashCode(a) for arrays
+ * of one primitive type, whose elements are ctype and are passed as argtype */
+#define ARRAY_OPS(scalaname, ctype, argtype, same, hash) \
+static void \
+fill_ ## scalaname(struct array *a, int32_t from, int32_t to, ctype v) \
+{ \
+  ctype *restrict data = ARRAY_DATA(a, ctype); \
+  if (sizeof(ctype) == 1) { \
+    memset(data + from, *(uint8_t*)&v, to - from); \
+    return; \
+  } \
+  for (int32_t i = from; i < to; i++) data[i] = v; \
+} \
+void \
+method__Ojava_Dutil_DArrays_Mfill_A_Nscala_D ## scalaname ## _Ascala_D ## scalaname ## _Rscala_DUnit( \
+    struct java_lang_Object *self, vtable_t selfVtable, \
+    struct array *a, vtable_t aVtable, argtype v) \
+{ \
+  rt_assertNotNull((struct java_lang_Object*)a); \
+  fill_ ## scalaname(a, 0, a->length, (ctype)v); \
+} \
+void \
+method__Ojava_Dutil_DArrays_Mfill_A_Nscala_D ## scalaname ## _Ascala_DInt_Ascala_DInt_Ascala_D ## scalaname ## _Rscala_DUnit( \
+    struct java_lang_Object *self, vtable_t selfVtable, \
+    struct array *a, vtable_t aVtable, int32_t from, int32_t to, argtype v) \
+{ \
+  rt_assertNotNull((struct java_lang_Object*)a); \
+  checkrange(a, from, to); \
+  fill_ ## scalaname(a, from, to, (ctype)v); \
+} \
+bool \
+method__Ojava_Dutil_DArrays_Mequals_A_Nscala_D ## scalaname ## _A_Nscala_D ## scalaname ## _Rscala_DBoolean( \
+    struct java_lang_Object *self, vtable_t selfVtable, \
+    struct array *a, vtable_t aVtable, struct array *b, vtable_t bVtable) \
+{ \
+  if (a == b) return true; \
+  if (a == NULL || b == NULL || a->length != b->length) return false; \
+  ctype *x = ARRAY_DATA(a, ctype); \
+  ctype *y = ARRAY_DATA(b, ctype); \
+  bool eq = true; \
+  for (int32_t i = 0; i < a->length; i++) eq &= same(x[i], y[i]); \
+  return eq; \
+} \
+int32_t \
+method__Ojava_Dutil_DArrays_MhashCode_A_Nscala_D ## scalaname ## _Rscala_DInt( \
+    struct java_lang_Object *self, vtable_t selfVtable, \
+    struct array *a, vtable_t aVtable) \
+{ \
+  if (a == NULL) return 0; \
+  ctype *x = ARRAY_DATA(a, ctype); \
+  uint32_t h = 1; \
+  for (int32_t i = 0; i < a->length; i++) h = 31 * h + (uint32_t)hash(x[i]); \
+  return (int32_t)h; \
+}
+
+ARRAY_OPS(Boolean, bool, bool, SAME_BITS, HASH_BOOL)
+ARRAY_OPS(Byte, int8_t, int8_t, SAME_BITS, HASH_INT)
+ARRAY_OPS(Short, int16_t, int16_t, SAME_BITS, HASH_INT)
+ARRAY_OPS(Char, uint16_t, int32_t, SAME_BITS, HASH_INT)
+ARRAY_OPS(Int, int32_t, int32_t, SAME_BITS, HASH_INT)
+ARRAY_OPS(Long, int64_t, int64_t, SAME_BITS, HASH_LONG)
+ARRAY_OPS(Float, float, float, SAME_FLOAT, HASH_FLOAT)
+ARRAY_OPS(Double, double, double, SAME_DOUBLE, HASH_DOUBLE)
+
+#undef ARRAY_OPS
+
+void
+method__Ojava_Dutil_DArrays_Mfill_A_Njava_Dlang_DObject_Ajava_Dlang_DObject_Rscala_DUnit(
+    struct java_lang_Object *self, vtable_t selfVtable,
+    struct array *a, vtable_t aVtable, struct java_lang_Object *v, vtable_t vVtable)
+{
+  rt_assertNotNull((struct java_lang_Object*)a);
+  if (v != NULL && !storable(v, a->super.klass->elementklass)) throwarraystore();
+  struct reference *data = ARRAY_DATA(a, struct reference);
+  struct reference r = { v, rt_loadvtable(v) };
+  for (int32_t i = 0; i < a->length; i++) data[i] = r;
+  rt_arraystore_barrier((struct java_lang_Object*)a, data, a->length);
 }
@@ -32,5 +32,17 @@ struct array {
 #define ARRAY_DATA(a,t) ((t*)(((char*)(a))+(a)->super.klass->eltsoffset))
 
 struct array *new_array(uint8_t k, struct klass *et, int32_t ndims, int32_t dim0, ...);
+extern void rt_assertArrayBounds(struct array *arr, int32_t i);
+extern void rt_throwArrayIndex(struct array *arr, int32_t i)
+  __attribute__((noinline, cold, noreturn));
+extern void rt_assertArrayRange(struct array *arr, int32_t lo, int32_t hi);
+
+/* One unsigned compare covers both i < 0 and i >= length. */
+static inline void
+rt_checkArrayIndex(struct array *arr, int32_t i)
+{
+  if (__builtin_expect((uint32_t)i >= (uint32_t)arr->length, 0))
+    rt_throwArrayIndex(arr, i);
+}
 
 #endif
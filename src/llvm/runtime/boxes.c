@@ -1,17 +1,29 @@
 #include "boxes.h"
 #include "runtime.h"
+#include "gc.h"
 
-#define DEFINE_BOX2(p,k,c,g)                                                      \
+/* Boxes
+ *
+ * Small values are boxed from per-class tables of immortal boxes, so boxing
+ * them never allocates and never touches the companion module. Other values
+ * go through the Scala valueOf. Every box class keeps its constructor
+ * argument as its only field, so unboxing is a plain load; unboxing null
+ * yields zero as it does on the JVM. */
+
+#define BOX_STRUCT(p,c)                                                           \
+  struct java_lang_ ## c ## _box {                                                \
+    struct java_lang_Object super;                                                \
+    p value;                                                                      \
+  };
+
+#define DEFINE_VALUEOF(p,k,c)                                                     \
   struct object_java_lang_ ## c;                                                  \
   extern struct object_java_lang_ ## c* module__Ojava_Dlang_D ## c;               \
   extern void initmodule_module__Ojava_Dlang_D ## c();                            \
   extern struct java_lang_Object*                                                 \
   method__Ojava_Dlang_D ## c ## _MvalueOf_Ascala_D ## k ## _Rjava_Dlang_D ## c    \
     (struct java_lang_Object*, vtable_t, p, vtable_t*);                           \
-  extern p                                                                        \
-  method_java_Dlang_D ## c ## _M ## g ## _Rscala_D ## k (                         \
-      struct java_lang_Object*, vtable_t);                                        \
-  struct java_lang_Object *rt_box_ ## c (p v)                                     \
+  static struct java_lang_Object *valueof_ ## c (p v)                             \
   {                                                                               \
     vtable_t vtbl;                                                                \
     initmodule_module__Ojava_Dlang_D ## c();                                      \
@@ -20,20 +32,73 @@
     return                                                                        \
     method__Ojava_Dlang_D ## c ## _MvalueOf_Ascala_D ## k ## _Rjava_Dlang_D ## c  \
     (mod, mod->klass->vtable, v, &vtbl);                                          \
-  }                                                                               \
+  }
+
+#define DEFINE_UNBOX(p,c)                                                         \
   p rt_unbox_ ## c(struct java_lang_Object *v)                                    \
   {                                                                               \
-    return                                                                        \
-    method_java_Dlang_D ## c ## _M ## g ## _Rscala_D ## k (v, rt_loadvtable(v));  \
+    if (v == NULL) return 0;                                                      \
+    return ((struct java_lang_ ## c ## _box*)v)->value;                           \
+  }
+
+/* Boxes for values in [lo, hi] come from a table filled on first use. */
+#define DEFINE_CACHED_BOX(p,k,c,lo,hi)                                            \
+  BOX_STRUCT(p,c)                                                                 \
+  DEFINE_VALUEOF(p,k,c)                                                           \
+  extern struct klass class_java_Dlang_D ## c;                                    \
+  extern void                                                                     \
+  method_java_Dlang_D ## c ## _M_Linit_G_Ascala_D ## k ## _Rjava_Dlang_D ## c     \
+    (struct java_lang_Object*, vtable_t, p);                                      \
+  static struct java_lang_Object *cache_ ## c [(hi) - (lo) + 1];                  \
+  static struct java_lang_Object *newcached_ ## c (p v)                           \
+  {                                                                               \
+    struct java_lang_Object *box = rt_new_immortal(&class_java_Dlang_D ## c);     \
+    method_java_Dlang_D ## c ## _M_Linit_G_Ascala_D ## k ## _Rjava_Dlang_D ## c   \
+      (box, rt_loadvtable(box), v);                                               \
+    cache_ ## c [v - (lo)] = box;                                                 \
+    return box;                                                                   \
+  }                                                                               \
+  struct java_lang_Object *rt_box_ ## c (p v)                                     \
+  {                                                                               \
+    if (v >= (lo) && v <= (hi)) {                                                 \
+      struct java_lang_Object *box = cache_ ## c [v - (lo)];                      \
+      return box != NULL ? box : newcached_ ## c (v);                             \
+    }                                                                             \
+    return valueof_ ## c (v);                                                     \
+  }                                                                               \
+  DEFINE_UNBOX(p,c)
+
+#define DEFINE_BOX(p,k,c)                                                         \
+  BOX_STRUCT(p,c)                                                                 \
+  DEFINE_VALUEOF(p,k,c)                                                           \
+  struct java_lang_Object *rt_box_ ## c (p v)                                     \
+  {                                                                               \
+    return valueof_ ## c (v);                                                     \
+  }                                                                               \
+  DEFINE_UNBOX(p,c)
+
+/* Boolean boxes are the module's TRUE and FALSE so that boxes made here are
+ * identical to those Scala code sees. */
+BOX_STRUCT(bool,Boolean)
+DEFINE_VALUEOF(bool,Boolean,Boolean)
+static struct java_lang_Object *cache_Boolean[2];
+
+struct java_lang_Object *rt_box_Boolean(bool v)
+{
+  struct java_lang_Object *box = cache_Boolean[v];
+  if (box == NULL) {
+    box = valueof_Boolean(v);
+    cache_Boolean[v] = box;
   }
+  return box;
+}
 
-#define DEFINE_BOX(p,c,g) DEFINE_BOX2(p,c,c,g)
+DEFINE_UNBOX(bool,Boolean)
 
-DEFINE_BOX(bool, Boolean, booleanValue);
-DEFINE_BOX(int8_t, Byte, byteValue);
-DEFINE_BOX(int16_t, Short, shortValue);
-DEFINE_BOX2(int32_t, Int, Integer, intValue);
-DEFINE_BOX(int64_t, Long, longValue);
-DEFINE_BOX(float, Float, floatValue);
-DEFINE_BOX(double, Double, doubleValue);
-DEFINE_BOX2(UChar32, Char, Character, charValue);
+DEFINE_CACHED_BOX(int8_t, Byte, Byte, -128, 127)
+DEFINE_CACHED_BOX(int16_t, Short, Short, -128, 127)
+DEFINE_CACHED_BOX(int32_t, Int, Integer, -128, 127)
+DEFINE_CACHED_BOX(int64_t, Long, Long, -128, 127)
+DEFINE_BOX(float, Float, Float)
+DEFINE_BOX(double, Double, Double)
+DEFINE_CACHED_BOX(UChar32, Char, Character, 0, 127)
@@ -2,6 +2,7 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <stdbool.h>
 #include <time.h>
 #include <assert.h>
@@ -22,6 +23,20 @@ struct gcobj {
   char obj[];
 };
 
+/* Objects that live outside the heap, in memory supplied by compiled code
+ * for allocations that cannot escape their frame, have sz == 0. They are
+ * traced like any other object but are never on the heap list, so they are
+ * never swept; while marking, prev links the ones visited. */
+#define STACKOBJ(gcp) ((gcp)->sz == 0)
+
+/* Interior objects are carved from the tail of a heap block whose head is an
+ * ordinary object, the owner. They have sz == INTERIOR_SZ and prev pointing
+ * at the owner; marking one marks its owner, and the whole block is freed
+ * with the owner. While marking, nextwork links the ones visited. */
+#define INTERIOR_SZ ((size_t)-1)
+#define INTERIOR(gcp) ((gcp)->sz == INTERIOR_SZ)
+#define OBJALIGN(n) (((n) + sizeof(int64_t) - 1) & ~(sizeof(int64_t) - 1))
+
 enum slottype {
   OPSTACK,
   LOCAL
@@ -37,6 +52,10 @@ struct stackslot {
 
 static struct gcobj* head = NULL;
 
+/* objects that are never collected (interned strings and the like); they
+ * are traced like roots but are not part of the heap list */
+static struct gcobj* immortals = NULL;
+
 /* 1MB shadow stack */
 #define STACK_SIZE (32L*1024L*1024L/sizeof(struct stackslot))
 static struct stackslot shadowstack[STACK_SIZE];
@@ -48,6 +67,15 @@ static struct java_lang_Object** staticroots[ROOT_SIZE];
 static struct java_lang_Object*** nextroot = &(staticroots[0]);
 static struct java_lang_Object*** rootlimit = &(staticroots[ROOT_SIZE]);
 
+/* native finalizers, run on dead instances of exactly these classes before
+ * they are freed */
+#define FINALIZER_SIZE (16)
+static struct finalizer {
+  struct klass *klass;
+  void (*fn)(struct java_lang_Object *);
+} finalizers[FINALIZER_SIZE];
+static size_t nfinalizers = 0;
+
 static size_t heapsize = 0;
 #define HEAPLIMIT (8L*1024L*1024L*1024L)
 #define INITHEAP (1024L*1024L*1024L)
@@ -75,8 +103,46 @@ struct java_lang_Object* rt_new(struct klass *klass)
   return obj;
 }
 
-struct java_lang_Object* gcalloc(size_t nbytes) {
+struct java_lang_Object* rt_new_immortal(struct klass *klass)
+{
+  struct java_lang_Object *obj = gcalloc_immortal(klass->instsize);
+  rt_initobj(obj, klass);
+  return obj;
+}
+
+size_t rt_stackobjsize(struct klass *klass)
+{
+  return sizeof(struct gcobj)+klass->instsize;
+}
+
+struct java_lang_Object* rt_initstackobj(void *mem, struct klass *klass)
+{
+  struct gcobj *gcp = (struct gcobj*)mem;
+  memset(gcp, 0, rt_stackobjsize(klass));
+  struct java_lang_Object *obj = gc2object(gcp);
+  rt_initobj(obj, klass);
+  return obj;
+}
+
+bool rt_isheapobj(struct java_lang_Object *obj)
+{
+  return obj != NULL && !STACKOBJ(object2gc(obj));
+}
+
+struct java_lang_Object* gcalloc_immortal(size_t nbytes) {
   size_t objsize = sizeof(struct gcobj)+nbytes;
+  struct gcobj* gcp = (struct gcobj*)calloc(1, objsize);
+  if (gcp == NULL) {
+    fprintf(stderr, "Out of memory\n");
+    abort();
+  }
+  gcp->sz = objsize;
+  gcp->prev = immortals;
+  immortals = gcp;
+  return gc2object(gcp);
+}
+
+static struct gcobj* heapalloc(size_t objsize) {
   if (heapsize + objsize > curmax) {
     marksweep();
     if (heapsize + objsize + HEAPINC > curmax) {
@@ -98,10 +164,33 @@ struct java_lang_Object* gcalloc(size_t nbytes) {
   }
 #endif
   heapsize += gcp->sz;
-  struct java_lang_Object* obj = gc2object(gcp);
   gcp->prev = head;
   head = gcp;
-  return obj;
+  return gcp;
+}
+
+struct java_lang_Object* gcalloc(size_t nbytes) {
+  return gc2object(heapalloc(sizeof(struct gcobj)+nbytes));
+}
+
+size_t rt_interiorsize(size_t nbytes)
+{
+  return OBJALIGN(sizeof(struct gcobj)+nbytes);
+}
+
+struct java_lang_Object* gcalloc_block(size_t nbytes, size_t interiorbytes, char **cursor) {
+  size_t headsize = OBJALIGN(sizeof(struct gcobj)+nbytes);
+  struct gcobj* gcp = heapalloc(headsize+interiorbytes);
+  *cursor = ((char*)gcp)+headsize;
+  return gc2object(gcp);
+}
+
+struct java_lang_Object* gcalloc_interior(struct java_lang_Object *owner, char **cursor, size_t nbytes) {
+  struct gcobj* gcp = (struct gcobj*)*cursor;
+  gcp->prev = object2gc(owner);
+  gcp->sz = INTERIOR_SZ;
+  *cursor += rt_interiorsize(nbytes);
+  return gc2object(gcp);
 }
 
 static void dumpshadow() {
@@ -126,6 +215,29 @@ void rt_addroot(struct java_lang_Object** obj) {
   *(nextroot++) = obj;
 }
 
+/* Called after count references starting at first were stored into array
+ * in bulk. The collector is not generational, so nothing is remembered; a
+ * card marking collector would dirty the cards covering the range here. */
+void rt_arraystore_barrier(struct java_lang_Object *array, struct reference *first, size_t count) {
+}
+
+void rt_setfinalizer(struct klass *klass, void (*fn)(struct java_lang_Object *)) {
+  for (size_t i = 0; i < nfinalizers; i++) {
+    if (finalizers[i].klass == klass) {
+      finalizers[i].fn = fn;
+      return;
+    }
+  }
+  if (nfinalizers == FINALIZER_SIZE) {
+    fprintf(stderr, "Too many finalizers\n");
+    fflush(stderr);
+    abort();
+  }
+  finalizers[nfinalizers].klass = klass;
+  finalizers[nfinalizers].fn = fn;
+  nfinalizers++;
+}
+
 void* rt_openframe() {
 #if GC_DEBUG >= 5
   fprintf(stderr, "openframe %p\n", shadowsp);
@@ -202,6 +314,8 @@ void marksweep() {
 #endif
   struct gcobj* workq = NULL;
   size_t workqsz = 0;
+  struct gcobj* stackobjs = NULL;
+  struct gcobj* interiors = NULL;
 #if GC_DEBUG >= 2
 #if GC_DEBUG >= 6
   dumpshadow();
@@ -224,6 +338,20 @@ void marksweep() {
       workq = cur;
     }
   }
+#if GC_DEBUG >= 2
+  fprintf(stderr, "scanning immortals\n");
+#endif
+  for (struct gcobj* cur = immortals; cur != NULL; cur = cur->prev) {
+    if (!cur->nextwork) {
+      workqsz++;
+      if (workq) {
+        cur->nextwork = workq;
+      } else {
+        cur->nextwork = cur;
+      }
+      workq = cur;
+    }
+  }
 #if GC_DEBUG >= 2
   fprintf(stderr, "scanning shadowstack\n");
 #endif
@@ -274,6 +402,21 @@ void marksweep() {
     workq = cur->nextwork;
     workqsz--;
     if (workq == cur) workq = NULL;
+    if (STACKOBJ(cur)) {
+      cur->prev = stackobjs;
+      stackobjs = cur;
+    }
+    struct gcobj* owner = cur;
+    if (INTERIOR(cur)) {
+      cur->nextwork = interiors ? interiors : cur;
+      interiors = cur;
+      owner = cur->prev;
+      if (owner->nextwork == NULL) {
+        owner->nextwork = workq ? workq : owner;
+        workq = owner;
+        workqsz++;
+      }
+    }
     struct java_lang_Object* obj = gc2object(cur);
 #if GC_DEBUG >= 4
     fprintf(stderr, "tracing %p, a %.*s\n", obj, obj->klass->name.len, obj->klass->name.bytes);
@@ -281,12 +424,15 @@ void marksweep() {
     struct klass* k = obj->klass;
     if (k->instsize == 0) {
       struct array* a = (struct array*)obj;
-      if (k->elementklass) {
+      if (k->eltisref) {
         struct reference* data = ARRAY_DATA(a, struct reference);
         for (size_t i = 0; i < a->length; i++) {
           struct java_lang_Object* p = (data+i)->object;
           if (p == NULL) continue;
           struct gcobj* gcp = object2gc(p);
+          /* rows of primitives carved from the block being traced hold no
+           * references and live exactly as long as it does */
+          if (INTERIOR(gcp) && gcp->prev == owner && !p->klass->eltisref) continue;
           if (gcp->nextwork == NULL) {
 #if GC_DEBUG >= 4
             fprintf(stderr, "adding %p to workq\n", p);
@@ -346,14 +492,33 @@ void marksweep() {
       head = cur;
       cur->nextwork = NULL;
     } else {
-#if 0
-      if (cur->klass-> == /*...*/) {
+      if (nfinalizers > 0) {
+        struct klass *k = gc2object(cur)->klass;
+        for (size_t i = 0; i < nfinalizers; i++) {
+          if (finalizers[i].klass == k) {
+            finalizers[i].fn(gc2object(cur));
+            break;
+          }
+        }
       }
-#endif
       heapsize -= cur->sz;
       free(cur);
     }
   }
+  for (struct gcobj* cur = immortals; cur != NULL; cur = cur->prev) {
+    cur->nextwork = NULL;
+  }
+  while (interiors) {
+    struct gcobj* cur = interiors;
+    interiors = cur->nextwork == cur ? NULL : cur->nextwork;
+    cur->nextwork = NULL;
+  }
+  while (stackobjs) {
+    struct gcobj* cur = stackobjs;
+    stackobjs = cur->prev;
+    cur->prev = NULL;
+    cur->nextwork = NULL;
+  }
 #if GC_DEBUG >= 1
   clock_t end = clock();
   fprintf(stderr, "done collecting, heapsize=%zu time %g seconds\n", heapsize, (float)(end-start)/CLOCKS_PER_SEC);
@@ -2,15 +2,29 @@
 #define GC_H
 
 #include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
 
 struct java_lang_Object;
+struct klass;
 
 struct java_lang_Object* gcalloc(size_t nbytes);
+struct java_lang_Object* gcalloc_immortal(size_t nbytes);
+struct java_lang_Object* gcalloc_block(size_t nbytes, size_t interiorbytes, char **cursor);
+struct java_lang_Object* gcalloc_interior(struct java_lang_Object *owner, char **cursor, size_t nbytes);
+size_t rt_interiorsize(size_t nbytes);
+struct java_lang_Object* rt_new_immortal(struct klass *klass);
 void rt_pushref(struct java_lang_Object* obj);
 void rt_popref();
 void rt_addroot(struct java_lang_Object** obj);
 void* rt_openframe();
 void rt_localcell(struct java_lang_Object** cell);
 void rt_closeframe(void *);
+size_t rt_stackobjsize(struct klass *klass);
+struct java_lang_Object* rt_initstackobj(void *mem, struct klass *klass);
+bool rt_isheapobj(struct java_lang_Object *obj);
+struct reference;
+void rt_arraystore_barrier(struct java_lang_Object *array, struct reference *first, size_t count);
+void rt_setfinalizer(struct klass *klass, void (*fn)(struct java_lang_Object *));
 
 #endif
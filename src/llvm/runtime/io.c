@@ -1,63 +1,440 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/uio.h>
 
 #include "strings.h"
+#include "arrays.h"
 
-#include "unicode/ustdio.h"
-#include "unicode/unum.h"
+#include "unicode/utf8.h"
+#include "unicode/utf16.h"
 
 
 struct java_lang_Object;
 
+/* Buffered Output
+ *
+ * Standard out and standard error each have a buffer that whole strings and
+ * byte array slices are transcoded into in bulk, drained with large write(2)
+ * calls. Standard error is drained at the end of every call. Standard out is
+ * drained when full, on flush, before anything is written to standard error,
+ * and at exit. */
+
+#define OUTBUF_SIZE 65536
+
+struct outbuf {
+  int fd;
+  bool unbuffered;
+  int32_t used;
+  char data[OUTBUF_SIZE];
+};
+
+static struct outbuf outbuf_stdout = { 1, false, 0 };
+static struct outbuf outbuf_stderr = { 2, true, 0 };
+static bool outbuf_initted = false;
+
+static void
+writeall(int fd, const char *data, size_t len)
+{
+  while (len > 0) {
+    ssize_t n = write(fd, data, len);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return;
+    }
+    data += n;
+    len -= n;
+  }
+}
+
+static void
+outdrain(struct outbuf *b)
+{
+  if (b->used > 0) {
+    writeall(b->fd, b->data, b->used);
+    b->used = 0;
+  }
+}
+
+void
+rt_flushoutput()
+{
+  outdrain(&outbuf_stdout);
+  outdrain(&outbuf_stderr);
+}
+
+static struct outbuf*
+outbegin(struct outbuf *b)
+{
+  if (!outbuf_initted) {
+    atexit(rt_flushoutput);
+    outbuf_initted = true;
+  }
+  if (b->unbuffered) {
+    /* keep the two streams in program order */
+    outdrain(&outbuf_stdout);
+  }
+  return b;
+}
+
+static void
+outend(struct outbuf *b)
+{
+  if (b->unbuffered) {
+    outdrain(b);
+  }
+}
+
+static inline void
+outroom(struct outbuf *b, int32_t n)
+{
+  if (OUTBUF_SIZE - b->used < n) {
+    outdrain(b);
+  }
+}
+
+static void
+outbytes(struct outbuf *b, const char *data, int32_t len)
+{
+  if (len > OUTBUF_SIZE - b->used) {
+    outdrain(b);
+    if (len >= OUTBUF_SIZE) {
+      /* large enough to skip the copy */
+      writeall(b->fd, data, len);
+      return;
+    }
+  }
+  memcpy(b->data + b->used, data, len);
+  b->used += len;
+}
+
+/* length of the leading run of ASCII bytes, tested a word at a time */
+static int32_t
+asciirun(const uint8_t *s, int32_t len)
+{
+  int32_t i = 0;
+  while (i + 8 <= len) {
+    uint64_t w;
+    memcpy(&w, s + i, 8);
+    if (w & UINT64_C(0x8080808080808080)) break;
+    i += 8;
+  }
+  while (i < len && s[i] < 0x80) i++;
+  return i;
+}
+
+static void
+outlatin1(struct outbuf *b, const uint8_t *s, int32_t len)
+{
+  int32_t i = 0;
+  while (i < len) {
+    outroom(b, 2);
+    int32_t room = OUTBUF_SIZE - b->used;
+    int32_t n = asciirun(s + i, len - i < room ? len - i : room);
+    memcpy(b->data + b->used, s + i, n);
+    b->used += n;
+    i += n;
+    if (i < len && s[i] >= 0x80 && OUTBUF_SIZE - b->used >= 2) {
+      b->data[b->used++] = 0xC0 | (s[i] >> 6);
+      b->data[b->used++] = 0x80 | (s[i] & 0x3F);
+      i++;
+    }
+  }
+}
+
+static void
+oututf16(struct outbuf *b, const UChar *s, int32_t len)
+{
+  int32_t i = 0;
+  while (i < len) {
+    UChar32 c;
+    outroom(b, U8_MAX_LENGTH);
+    U16_NEXT(s, i, len, c);
+    if (U_IS_SURROGATE(c)) c = 0xFFFD;
+    U8_APPEND_UNSAFE((uint8_t*)b->data, b->used, c);
+  }
+}
+
+static void
+outstring(struct outbuf *b, struct java_lang_String *s)
+{
+  if (s->coder == CODER_LATIN1) {
+    outlatin1(b, s->chars.latin1, s->len);
+  } else {
+    oututf16(b, s->chars.utf16, s->len);
+  }
+}
+
+static void
+outslice(struct outbuf *b, struct array *arr, int32_t off, int32_t len)
+{
+  rt_assertNotNull((struct java_lang_Object*)arr);
+  if (off < 0 || len < 0 || off > arr->length - len) {
+    rt_assertArrayBounds(arr, off < 0 ? off : arr->length);
+  }
+  outbytes(b, ARRAY_DATA(arr, char) + off, len);
+}
+
 void
 method__Ojava_Dlang_DStandardError_Mwrite_Ascala_DInt_Rscala_DUnit(
     struct java_lang_Object *self, vtable_t selfVtable, int32_t b)
 {
-  fputc(b, stderr);
+  struct outbuf *out = outbegin(&outbuf_stderr);
+  char c = b;
+  outbytes(out, &c, 1);
+  outend(out);
+}
+
+void
+method__Ojava_Dlang_DStandardError_Mwrite_A_Nscala_DByte_Ascala_DInt_Ascala_DInt_Rscala_DUnit(
+    struct java_lang_Object *self, vtable_t selfVtable,
+    struct array *b, vtable_t bVtable, int32_t off, int32_t len)
+{
+  struct outbuf *out = outbegin(&outbuf_stderr);
+  outslice(out, b, off, len);
+  outend(out);
+}
+
+void
+method__Ojava_Dlang_DStandardError_MwriteString_Ajava_Dlang_DString_Rscala_DUnit(
+    struct java_lang_Object *self, vtable_t selfVtable,
+    struct java_lang_Object *s, vtable_t sVtable)
+{
+  struct outbuf *out = outbegin(&outbuf_stderr);
+  outstring(out, (struct java_lang_String*)s);
+  outend(out);
 }
 
 void
 method__Ojava_Dlang_DStandardError_Mflush_Rscala_DUnit(
     struct java_lang_Object *self, vtable_t selfVtable)
 {
-  fflush(stderr);
+  outdrain(&outbuf_stderr);
+}
+
+bool
+method__Ojava_Dlang_DStandardError_Minteractive_Rscala_DBoolean(
+    struct java_lang_Object *self, vtable_t selfVtable)
+{
+  return isatty(outbuf_stderr.fd);
 }
 
 void
 method__Ojava_Dlang_DStandardOut_Mwrite_Ascala_DInt_Rscala_DUnit(
     struct java_lang_Object *self, vtable_t selfVtable, int32_t b)
 {
-  fputc(b, stdout);
+  struct outbuf *out = outbegin(&outbuf_stdout);
+  char c = b;
+  outbytes(out, &c, 1);
+  outend(out);
+}
+
+void
+method__Ojava_Dlang_DStandardOut_Mwrite_A_Nscala_DByte_Ascala_DInt_Ascala_DInt_Rscala_DUnit(
+    struct java_lang_Object *self, vtable_t selfVtable,
+    struct array *b, vtable_t bVtable, int32_t off, int32_t len)
+{
+  struct outbuf *out = outbegin(&outbuf_stdout);
+  outslice(out, b, off, len);
+  outend(out);
+}
+
+void
+method__Ojava_Dlang_DStandardOut_MwriteString_Ajava_Dlang_DString_Rscala_DUnit(
+    struct java_lang_Object *self, vtable_t selfVtable,
+    struct java_lang_Object *s, vtable_t sVtable)
+{
+  struct outbuf *out = outbegin(&outbuf_stdout);
+  outstring(out, (struct java_lang_String*)s);
+  outend(out);
 }
 
 void
 method__Ojava_Dlang_DStandardOut_Mflush_Rscala_DUnit(
     struct java_lang_Object *self, vtable_t selfVtable)
 {
-  fflush(stdout);
+  outdrain(&outbuf_stdout);
+}
+
+bool
+method__Ojava_Dlang_DStandardOut_Minteractive_Rscala_DBoolean(
+    struct java_lang_Object *self, vtable_t selfVtable)
+{
+  return isatty(outbuf_stdout.fd);
+}
+
+/* Native File I/O
+ *
+ * java.io.NativeIO moves byte array ranges directly between the array data and
+ * a file descriptor without an intermediate copy. Results are whatever the
+ * system call returns, with failures reported as -errno. */
+
+#define NATIVEIO_READ     1
+#define NATIVEIO_WRITE    2
+#define NATIVEIO_APPEND   4
+#define NATIVEIO_CREATE   8
+#define NATIVEIO_TRUNCATE 16
+
+#define NATIVEIO_MAXIOV 64
+
+static void
+checkslice(struct array *arr, int32_t off, int32_t len)
+{
+  rt_assertNotNull((struct java_lang_Object*)arr);
+  if (off < 0 || len < 0 || off > arr->length - len) {
+    rt_assertArrayBounds(arr, off < 0 ? off : arr->length);
+  }
+}
+
+int32_t
+method__Ojava_Dio_DNativeIO_Mopen_Ajava_Dlang_DString_Ascala_DInt_Rscala_DInt(
+    struct java_lang_Object *self, vtable_t selfVtable,
+    struct java_lang_Object *path, vtable_t pathVtable, int32_t mode)
+{
+  char *bytes;
+  int32_t len;
+  int flags = 0;
+  int fd;
+  rt_assertNotNull(path);
+  if (!rt_stringtoutf8((struct java_lang_String*)path, &bytes, &len)) return -EINVAL;
+  bytes = realloc(bytes, len + 1);
+  bytes[len] = 0;
+  if ((mode & NATIVEIO_READ) && (mode & NATIVEIO_WRITE)) flags = O_RDWR;
+  else if (mode & NATIVEIO_WRITE) flags = O_WRONLY;
+  else flags = O_RDONLY;
+  if (mode & NATIVEIO_APPEND) flags |= O_APPEND;
+  if (mode & NATIVEIO_CREATE) flags |= O_CREAT;
+  if (mode & NATIVEIO_TRUNCATE) flags |= O_TRUNC;
+  do {
+    fd = open(bytes, flags | O_CLOEXEC, 0666);
+  } while (fd < 0 && errno == EINTR);
+  free(bytes);
+  return fd < 0 ? -errno : fd;
 }
 
-UFILE* ustderr() {
-  static UFILE *uout = NULL;
-  if (uout == NULL) {
-    uout = u_finit(stderr, NULL, NULL);
+int32_t
+method__Ojava_Dio_DNativeIO_Mclose_Ascala_DInt_Rscala_DInt(
+    struct java_lang_Object *self, vtable_t selfVtable, int32_t fd)
+{
+  return close(fd) < 0 ? -errno : 0;
+}
+
+int32_t
+method__Ojava_Dio_DNativeIO_Mread_Ascala_DInt_A_Nscala_DByte_Ascala_DInt_Ascala_DInt_Rscala_DInt(
+    struct java_lang_Object *self, vtable_t selfVtable, int32_t fd,
+    struct array *b, vtable_t bVtable, int32_t off, int32_t len)
+{
+  ssize_t n;
+  checkslice(b, off, len);
+  do {
+    n = read(fd, ARRAY_DATA(b, char) + off, len);
+  } while (n < 0 && errno == EINTR);
+  return n < 0 ? -errno : n;
+}
+
+int32_t
+method__Ojava_Dio_DNativeIO_Mwrite_Ascala_DInt_A_Nscala_DByte_Ascala_DInt_Ascala_DInt_Rscala_DInt(
+    struct java_lang_Object *self, vtable_t selfVtable, int32_t fd,
+    struct array *b, vtable_t bVtable, int32_t off, int32_t len)
+{
+  ssize_t n;
+  checkslice(b, off, len);
+  do {
+    n = write(fd, ARRAY_DATA(b, char) + off, len);
+  } while (n < 0 && errno == EINTR);
+  return n < 0 ? -errno : n;
+}
+
+/* Gather the ranges bufs(i)(offs(i) until offs(i)+lens(i)) into an iovec,
+ * validating each one before any I/O happens. */
+static int32_t
+filliov(struct iovec *iov, struct array *bufs, struct array *offs, struct array *lens, int32_t first, int32_t count)
+{
+  struct reference *bufdata = ARRAY_DATA(bufs, struct reference);
+  int32_t *offdata = ARRAY_DATA(offs, int32_t);
+  int32_t *lendata = ARRAY_DATA(lens, int32_t);
+  for (int32_t i = 0; i < count; i++) {
+    struct array *b = (struct array*)bufdata[first + i].object;
+    checkslice(b, offdata[first + i], lendata[first + i]);
+    iov[i].iov_base = ARRAY_DATA(b, char) + offdata[first + i];
+    iov[i].iov_len = lendata[first + i];
   }
-  return uout;
+  return count;
 }
 
-UFILE* ustdout() {
-  static UFILE *uout = NULL;
-  if (uout == NULL) {
-    uout = u_finit(stdout, NULL, NULL);
+static int64_t
+vectorio(int fd, struct array *bufs, struct array *offs, struct array *lens, bool writing)
+{
+  struct iovec iov[NATIVEIO_MAXIOV];
+  int64_t total = 0;
+  rt_assertNotNull((struct java_lang_Object*)bufs);
+  rt_assertNotNull((struct java_lang_Object*)offs);
+  rt_assertNotNull((struct java_lang_Object*)lens);
+  if (offs->length < bufs->length) rt_assertArrayBounds(offs, bufs->length - 1);
+  if (lens->length < bufs->length) rt_assertArrayBounds(lens, bufs->length - 1);
+  for (int32_t first = 0; first < bufs->length; first += NATIVEIO_MAXIOV) {
+    int32_t count = bufs->length - first;
+    int64_t want = 0;
+    ssize_t n;
+    if (count > NATIVEIO_MAXIOV) count = NATIVEIO_MAXIOV;
+    filliov(iov, bufs, offs, lens, first, count);
+    for (int32_t i = 0; i < count; i++) want += iov[i].iov_len;
+    do {
+      n = writing ? writev(fd, iov, count) : readv(fd, iov, count);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) return total > 0 ? total : -errno;
+    total += n;
+    /* stop at a short transfer like the system calls do */
+    if (n < want) break;
   }
-  return uout;
+  return total;
+}
+
+int64_t
+method__Ojava_Dio_DNativeIO_Mreadv_Ascala_DInt_A_N_Nscala_DByte_A_Nscala_DInt_A_Nscala_DInt_Rscala_DLong(
+    struct java_lang_Object *self, vtable_t selfVtable, int32_t fd,
+    struct array *bufs, vtable_t bufsVtable,
+    struct array *offs, vtable_t offsVtable,
+    struct array *lens, vtable_t lensVtable)
+{
+  return vectorio(fd, bufs, offs, lens, false);
+}
+
+int64_t
+method__Ojava_Dio_DNativeIO_Mwritev_Ascala_DInt_A_N_Nscala_DByte_A_Nscala_DInt_A_Nscala_DInt_Rscala_DLong(
+    struct java_lang_Object *self, vtable_t selfVtable, int32_t fd,
+    struct array *bufs, vtable_t bufsVtable,
+    struct array *offs, vtable_t offsVtable,
+    struct array *lens, vtable_t lensVtable)
+{
+  return vectorio(fd, bufs, offs, lens, true);
+}
+
+struct java_lang_Object*
+method__Ojava_Dio_DNativeIO_Mstrerror_Ascala_DInt_Rjava_Dlang_DString(
+    struct java_lang_Object *self, vtable_t selfVtable, int32_t err,
+    vtable_t *vtableOut)
+{
+  struct utf8str msg;
+  msg.bytes = strerror(err);
+  msg.len = strlen(msg.bytes);
+  struct java_lang_Object *ret = (struct java_lang_Object*)rt_makestring(&msg);
+  *vtableOut = rt_loadvtable(ret);
+  return ret;
 }
 
 void
 method__Ojava_Dlang_DSystem_MdebugString_Ajava_Dlang_DString_Rscala_DUnit(struct java_lang_Object *self, vtable_t selfVtable, struct java_lang_Object *sobj, vtable_t *sVtable)
 {
-  struct java_lang_String *s = (struct java_lang_String*)sobj;
-  u_file_write(s->s, s->len, ustderr());
+  struct outbuf *out = outbegin(&outbuf_stderr);
+  outstring(out, (struct java_lang_String*)sobj);
+  outend(out);
 }
 
 void
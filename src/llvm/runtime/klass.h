@@ -5,6 +5,8 @@
 #include <stdbool.h>
 #include <stddef.h>
 
+struct java_lang_Class;
+
 struct utf8str {
   int32_t len;
   char *bytes;
@@ -15,6 +17,17 @@ struct ifaceinfo {
   void **vtable;
 };
 
+/* ifacebits has bit n set for each implemented interface whose ifaceid is n */
+struct itable {
+  uint32_t mask;
+  uint32_t nbits;
+  uint64_t *ifacebits;
+  struct ifaceinfo slots[];
+};
+
+/* ancestors recorded in a klass's display, root first */
+#define DISPLAY_SIZE 8
+
 struct klass {
   struct utf8str name;
   uint32_t instsize;
@@ -25,6 +38,19 @@ struct klass {
   uint32_t npointers;
 #define eltsoffset npointers
   uint32_t numiface;
+  /* hashed copy of ifaces, built on first use; see rt_iface_lookup */
+  struct itable *itable;
+  /* the canonical java.lang.Class for this klass, created on first use */
+  struct java_lang_Class *classobj;
+  /* number of superclasses; display[depth] is the klass itself */
+  uint32_t depth;
+  /* for interfaces, a nonzero id assigned by the runtime on first use */
+  uint32_t ifaceid;
+  /* for arrays, the size of an element and whether elements are references;
+   * eltsize is 0 for every other klass */
+  uint32_t eltsize;
+  uint32_t eltisref;
+  struct klass *display[DISPLAY_SIZE];
   struct ifaceinfo ifaces[];
 };
 
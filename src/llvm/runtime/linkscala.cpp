@@ -1,28 +1,108 @@
 #include "config.h"
 
+#include <cstring>
 #include <string>
+#include <vector>
 
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Bitcode/Archive.h"
 #include "llvm/Bitcode/ReaderWriter.h"
 #include "llvm/LLVMContext.h"
+#include "llvm/PassManager.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Module.h"
+#include "llvm/Support/FormattedStream.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Target/TargetData.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/TargetRegistry.h"
+#include "llvm/Target/TargetSelect.h"
 #if LLVM_MAJOR_VERSION >=2 && LLVM_MINOR_VERSION >= 9
 # include "llvm/ADT/OwningPtr.h"
+# include "llvm/Support/Host.h"
+# include "llvm/Support/Path.h"
 # include "llvm/Support/Process.h"
+# include "llvm/Support/Program.h"
 # include "llvm/Support/Signals.h"
 # include "llvm/Support/system_error.h"
 #else
+# include "llvm/System/Host.h"
+# include "llvm/System/Path.h"
 # include "llvm/System/Process.h"
+# include "llvm/System/Program.h"
 # include "llvm/System/Signals.h"
 #endif
 #include "wrapper.h"
 
 using namespace llvm;
 
+/* Output kinds: the program as bitcode (what runscala and llvm-ld take),
+ * or compiled by the target backend to an object file or to an
+ * executable linked against the native runtime. Native code is generated
+ * as assembly and handed to the system compiler driver, which assembles
+ * and links it. */
+enum OutputKind { OutputBitcode, OutputObject, OutputExecutable };
+
+static void usage(const char *argv0)
+{
+  errs() << "usage: " << argv0 << " [-O0|-O1|-O2|-O3] [-c|-native] [-lto] [-rt=dir]"
+         << " [-Ldir] [-llib] [-o file] program.bc module\n";
+  exit(1);
+}
+
+static TargetMachine *createHostTargetMachine(Module &m, std::string &err)
+{
+  std::string triple = m.getTargetTriple();
+  if (triple.empty()) {
+    triple = sys::getHostTriple();
+    m.setTargetTriple(triple);
+  }
+  const Target *target = TargetRegistry::lookupTarget(triple, err);
+  if (!target) return NULL;
+  /* executables may be position independent */
+  TargetMachine::setRelocationModel(Reloc::PIC_);
+  return target->createTargetMachine(triple, "");
+}
+
+static bool emitAssembly(Module &m, TargetMachine &tm, unsigned level, const std::string &path)
+{
+  std::string err;
+  raw_fd_ostream out(path.c_str(), err);
+  if (!err.empty()) {
+    errs() << "Error opening output file " << path << ": " << err << "\n";
+    return false;
+  }
+  formatted_raw_ostream fout(out);
+  PassManager pm;
+  pm.add(new TargetData(*tm.getTargetData()));
+  if (tm.addPassesToEmitFile(pm, fout, TargetMachine::CGFT_AssemblyFile, codeGenOptLevel(level))) {
+    errs() << "The target cannot emit assembly\n";
+    return false;
+  }
+  pm.run(m);
+  return true;
+}
+
+static int runDriver(std::vector<std::string> &args)
+{
+  sys::Path driver = sys::Program::FindProgramByName("c++");
+  if (driver.isEmpty()) {
+    errs() << "Cannot find the system compiler driver c++\n";
+    return -1;
+  }
+  std::vector<const char*> argv;
+  argv.push_back("c++");
+  for (size_t i = 0; i < args.size(); i++) argv.push_back(args[i].c_str());
+  argv.push_back(0);
+  std::string err;
+  int res = sys::Program::ExecuteAndWait(driver, &argv[0], 0, 0, 0, 0, &err);
+  if (res != 0) {
+    errs() << "c++ failed" << (err.empty() ? "" : ": ") << err << "\n";
+  }
+  return res;
+}
+
 int main(int argc, char *argv[], char * const *envp)
 {
   sys::PrintStackTraceOnErrorSignal();
@@ -31,35 +111,75 @@ int main(int argc, char *argv[], char * const *envp)
   //cl::ParseCommandLineOptions(argc, argv, "scala runner");
   std::string ErrorMsg;
 
+  unsigned OptLevel = 0;
+  OutputKind Output = OutputBitcode;
+  bool LTO = false;
+  std::string OutputFile;
+  /* where llvmrt.a, llvmrt_native.a and unwind.o are; by default the
+   * directory linkscala is in */
+  std::string RuntimeDir;
+  std::vector<std::string> LinkArgs;
+  int argi = 1;
+  for (; argi < argc && argv[argi][0] == '-'; argi++) {
+    const char *opt = argv[argi];
+    if (opt[1] == 'O' && opt[2] >= '0' && opt[2] <= '3' && opt[3] == 0) {
+      OptLevel = opt[2] - '0';
+    } else if (strcmp(opt, "-c") == 0) {
+      Output = OutputObject;
+    } else if (strcmp(opt, "-native") == 0) {
+      Output = OutputExecutable;
+    } else if (strcmp(opt, "-lto") == 0) {
+      LTO = true;
+    } else if (strncmp(opt, "-rt=", 4) == 0) {
+      RuntimeDir = opt + 4;
+    } else if ((opt[1] == 'L' || opt[1] == 'l') && opt[2] != 0) {
+      LinkArgs.push_back(opt);
+    } else if (strcmp(opt, "-o") == 0 && argi + 1 < argc) {
+      OutputFile = argv[++argi];
+    } else {
+      errs() << argv[0] << ": unknown option '" << opt << "'\n";
+      usage(argv[0]);
+    }
+  }
+  if (argc - argi != 2) usage(argv[0]);
+  const char *ProgramFile = argv[argi];
+  if (RuntimeDir.empty()) {
+    std::string self(argv[0]);
+    size_t slash = self.find_last_of('/');
+    RuntimeDir = slash == std::string::npos ? "." : self.substr(0, slash);
+  }
+  if (OutputFile.empty()) {
+    OutputFile = Output == OutputBitcode ? "b.out.bc" : Output == OutputObject ? "b.out.o" : "b.out";
+  }
+
   Module *Mod = NULL;
 #if LLVM_MAJOR_VERSION >= 2 && LLVM_MINOR_VERSION >= 9
   OwningPtr<MemoryBuffer> Buffer;
-  error_code errc = MemoryBuffer::getFileOrSTDIN(argv[1], Buffer);
+  error_code errc = MemoryBuffer::getFileOrSTDIN(ProgramFile, Buffer);
   if (errc) {
-    errs() << argv[0] << ": error load program '" << argv[1] << "': " << errc.message() << "\n";
+    errs() << argv[0] << ": error load program '" << ProgramFile << "': " << errc.message() << "\n";
     exit(1);
   } else {
-    Mod = getLazyBitcodeModule(Buffer.get(), Context, &ErrorMsg);
+    Mod = getLazyBitcodeModule(Buffer.take(), Context, &ErrorMsg);
   }
   if (!Mod) {
-    errs() << argv[0] << ": error loading program '" << argv[1] << "': "
+    errs() << argv[0] << ": error loading program '" << ProgramFile << "': "
            << ErrorMsg << "\n";
     exit(1);
   }
-  outs() << "loaded module " << Mod << " " << Buffer << " " << Buffer.get() << "\n";
 #else
-  if (MemoryBuffer *Buffer = MemoryBuffer::getFileOrSTDIN(argv[1],&ErrorMsg)) {
+  if (MemoryBuffer *Buffer = MemoryBuffer::getFileOrSTDIN(ProgramFile,&ErrorMsg)) {
     Mod = getLazyBitcodeModule(Buffer, Context, &ErrorMsg);
     if (!Mod) delete Buffer;
   }
   if (!Mod) {
-    errs() << argv[0] << ": error loading program '" << argv[1] << "': "
+    errs() << argv[0] << ": error loading program '" << ProgramFile << "': "
            << ErrorMsg << "\n";
     exit(1);
   }
 #endif
 
-  std::string modid(argv[2]);
+  std::string modid(argv[argi+1]);
 
   std::string modulename;
   modulename += "module__O";
@@ -95,16 +215,68 @@ int main(int argc, char *argv[], char * const *envp)
   }
 
 
-  Function *wrapper = createMainWrapperFunction(*Mod, EntryFn, ModuleInstance, InitFn, "main");
+  createMainWrapperFunction(*Mod, EntryFn, ModuleInstance, InitFn, "main");
 
   Mod->MaterializeAllPermanently();
 
-  raw_fd_ostream out("b.out.bc", ErrorMsg);
-  if (!ErrorMsg.empty()) {
-    errs() << "Error opening output file:" << ErrorMsg << "\n";
-    return -1;
+  /* whole program: the runtime's bitcode is optimized along with the
+   * program, and the native runtime is not linked */
+  std::vector<const char*> Exports;
+  if (LTO) {
+    if (!linkRuntime(Mod, RuntimeDir + "/llvmrt.a", &ErrorMsg)) {
+      errs() << "Error linking the runtime: " << ErrorMsg << "\n";
+      return -1;
+    }
+    Exports.push_back("main");
   }
-  WriteBitcodeToFile(Mod, out);
 
-  return 0;
+  TargetMachine *TM = NULL;
+  if (OptLevel > 0 || LTO || Output != OutputBitcode) {
+    InitializeNativeTarget();
+#if LLVM_MAJOR_VERSION >= 2 && LLVM_MINOR_VERSION >= 9
+    InitializeNativeTargetAsmPrinter();
+#elif defined(LLVM_NATIVE_ASMPRINTER)
+    LLVM_NATIVE_ASMPRINTER();
+#endif
+    TM = createHostTargetMachine(*Mod, ErrorMsg);
+    if (!TM) {
+      errs() << "Error creating the target: " << ErrorMsg << "\n";
+      return -1;
+    }
+  }
+
+  if (OptLevel > 0 || LTO) {
+    optimizeModule(*Mod, OptLevel, TM->getTargetData(), LTO ? &Exports : NULL);
+  }
+
+  if (Output == OutputBitcode) {
+    raw_fd_ostream out(OutputFile.c_str(), ErrorMsg);
+    if (!ErrorMsg.empty()) {
+      errs() << "Error opening output file:" << ErrorMsg << "\n";
+      return -1;
+    }
+    WriteBitcodeToFile(Mod, out);
+    return 0;
+  }
+
+  std::string AsmFile = OutputFile + ".s";
+  if (!emitAssembly(*Mod, *TM, OptLevel, AsmFile)) return -1;
+
+  std::vector<std::string> args;
+  if (Output == OutputObject) {
+    args.push_back("-c");
+  }
+  args.push_back("-o");
+  args.push_back(OutputFile);
+  args.push_back(AsmFile);
+  if (Output == OutputExecutable) {
+    if (!LTO) args.push_back(RuntimeDir + "/llvmrt_native.a");
+    args.push_back(RuntimeDir + "/unwind.o");
+    args.insert(args.end(), LinkArgs.begin(), LinkArgs.end());
+    args.push_back("-lm");
+    args.push_back("-ldl");
+  }
+  int res = runDriver(args);
+  sys::Path(AsmFile).eraseFromDisk();
+  return res == 0 ? 0 : -1;
 }
@@ -0,0 +1,232 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "runtime.h"
+#include "strings.h"
+#include "arrays.h"
+#include "gc.h"
+
+/* Memory Mapped Files
+ *
+ * scala.runtime.MappedBuffer holds a handle to a struct mapping. The mapping
+ * is released by close() or, failing that, by a finalizer the collector runs
+ * when the buffer dies. A closed mapping has length zero so every access
+ * fails its bounds check. Multi-byte values use native byte order. */
+
+struct mapping {
+  uint8_t *addr;
+  int64_t length;
+  bool writable;
+};
+
+struct scala_runtime_MappedBuffer {
+  struct java_lang_Object super;
+  int64_t handle;
+};
+
+#define ADVISE_NORMAL     0
+#define ADVISE_SEQUENTIAL 1
+#define ADVISE_RANDOM     2
+#define ADVISE_WILLNEED   3
+#define ADVISE_DONTNEED   4
+
+extern struct klass class_scala_Druntime_DMappedBuffer;
+extern struct klass class_java_Dlang_DIndexOutOfBoundsException;
+extern struct klass class_java_Dlang_DUnsupportedOperationException;
+
+extern void
+method_java_Dlang_DIndexOutOfBoundsException_M_Linit_G_Rjava_Dlang_DIndexOutOfBoundsException(
+    struct java_lang_Object *, vtable_t);
+extern void
+method_java_Dlang_DUnsupportedOperationException_M_Linit_G_Rjava_Dlang_DUnsupportedOperationException(
+    struct java_lang_Object *, vtable_t);
+
+static void
+unmap(struct mapping *m)
+{
+  if (m->addr != NULL) {
+    munmap(m->addr, m->length);
+    m->addr = NULL;
+    m->length = 0;
+  }
+}
+
+static void
+finalizebuffer(struct java_lang_Object *obj)
+{
+  struct mapping *m = (struct mapping*)(intptr_t)((struct scala_runtime_MappedBuffer*)obj)->handle;
+  if (m != NULL) {
+    unmap(m);
+    free(m);
+  }
+}
+
+static struct mapping*
+getmapping(struct java_lang_Object *self)
+{
+  return (struct mapping*)(intptr_t)((struct scala_runtime_MappedBuffer*)self)->handle;
+}
+
+/* address of nbytes starting at pos, or throws */
+static inline uint8_t*
+region(struct java_lang_Object *self, int64_t pos, int64_t nbytes)
+{
+  struct mapping *m = getmapping(self);
+  if (pos < 0 || nbytes < 0 || pos > m->length - nbytes) {
+    rt_throw_new(&class_java_Dlang_DIndexOutOfBoundsException,
+        method_java_Dlang_DIndexOutOfBoundsException_M_Linit_G_Rjava_Dlang_DIndexOutOfBoundsException);
+  }
+  return m->addr + pos;
+}
+
+static inline uint8_t*
+writableregion(struct java_lang_Object *self, int64_t pos, int64_t nbytes)
+{
+  if (!getmapping(self)->writable) {
+    rt_throw_new(&class_java_Dlang_DUnsupportedOperationException,
+        method_java_Dlang_DUnsupportedOperationException_M_Linit_G_Rjava_Dlang_DUnsupportedOperationException);
+  }
+  return region(self, pos, nbytes);
+}
+
+static inline void
+checkslice(struct array *arr, int32_t off, int32_t len)
+{
+  rt_assertNotNull((struct java_lang_Object*)arr);
+  if (off < 0 || len < 0 || off > arr->length - len) {
+    rt_assertArrayBounds(arr, off < 0 ? off : arr->length);
+  }
+}
+
+int64_t
+method__Oscala_Druntime_DMappedBuffer_Mmap_Ajava_Dlang_DString_Ascala_DBoolean_Rscala_DLong(
+    struct java_lang_Object *self, vtable_t selfVtable,
+    struct java_lang_Object *path, vtable_t pathVtable, bool writable)
+{
+  static bool finalizer_registered = false;
+  char *bytes;
+  int32_t len;
+  int fd;
+  struct stat st;
+  void *addr;
+  struct mapping *m;
+  rt_assertNotNull(path);
+  if (!finalizer_registered) {
+    rt_setfinalizer(&class_scala_Druntime_DMappedBuffer, finalizebuffer);
+    finalizer_registered = true;
+  }
+  if (!rt_stringtoutf8((struct java_lang_String*)path, &bytes, &len)) return -EINVAL;
+  bytes = realloc(bytes, len + 1);
+  bytes[len] = 0;
+  do {
+    fd = open(bytes, (writable ? O_RDWR : O_RDONLY) | O_CLOEXEC);
+  } while (fd < 0 && errno == EINTR);
+  free(bytes);
+  if (fd < 0) return -errno;
+  if (fstat(fd, &st) < 0) {
+    int err = errno;
+    close(fd);
+    return -err;
+  }
+  if (st.st_size == 0) {
+    /* mmap refuses empty mappings */
+    addr = NULL;
+  } else {
+    addr = mmap(NULL, st.st_size, PROT_READ | (writable ? PROT_WRITE : 0), MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+      int err = errno;
+      close(fd);
+      return -err;
+    }
+  }
+  /* the mapping stays valid after the descriptor is closed */
+  close(fd);
+  m = malloc(sizeof(struct mapping));
+  m->addr = addr;
+  m->length = st.st_size;
+  m->writable = writable;
+  return (int64_t)(intptr_t)m;
+}
+
+int64_t
+method_scala_Druntime_DMappedBuffer_Mlength_Rscala_DLong(
+    struct java_lang_Object *self, vtable_t selfVtable)
+{
+  return getmapping(self)->length;
+}
+
+void
+method_scala_Druntime_DMappedBuffer_Mclose_Rscala_DUnit(
+    struct java_lang_Object *self, vtable_t selfVtable)
+{
+  unmap(getmapping(self));
+}
+
+void
+method_scala_Druntime_DMappedBuffer_Madvise_Ascala_DInt_Rscala_DUnit(
+    struct java_lang_Object *self, vtable_t selfVtable, int32_t advice)
+{
+  struct mapping *m = getmapping(self);
+  int a;
+  switch (advice) {
+    case ADVISE_SEQUENTIAL: a = POSIX_MADV_SEQUENTIAL; break;
+    case ADVISE_RANDOM:     a = POSIX_MADV_RANDOM; break;
+    case ADVISE_WILLNEED:   a = POSIX_MADV_WILLNEED; break;
+    case ADVISE_DONTNEED:   a = POSIX_MADV_DONTNEED; break;
+    default:                a = POSIX_MADV_NORMAL; break;
+  }
+  /* only a hint, so failures are ignored */
+  if (m->addr != NULL) posix_madvise(m->addr, m->length, a);
+}
+
+int8_t
+method_scala_Druntime_DMappedBuffer_Mget_Ascala_DLong_Rscala_DByte(
+    struct java_lang_Object *self, vtable_t selfVtable, int64_t pos)
+{
+  return *(int8_t*)region(self, pos, 1);
+}
+
+void
+method_scala_Druntime_DMappedBuffer_Mput_Ascala_DLong_Ascala_DByte_Rscala_DUnit(
+    struct java_lang_Object *self, vtable_t selfVtable, int64_t pos, int8_t b)
+{
+  *(int8_t*)writableregion(self, pos, 1) = b;
+}
+
+/* Bulk accessors copy len elements between the buffer at byte offset pos and
+ * the array starting at element off. */
+#define BULK_ACCESSORS(scalaname, ctype) \
+void \
+method_scala_Druntime_DMappedBuffer_Mget_Ascala_DLong_A_Nscala_D ## scalaname ## _Ascala_DInt_Ascala_DInt_Rscala_DUnit( \
+    struct java_lang_Object *self, vtable_t selfVtable, int64_t pos, \
+    struct array *dst, vtable_t dstVtable, int32_t off, int32_t len) \
+{ \
+  checkslice(dst, off, len); \
+  memcpy(ARRAY_DATA(dst, ctype) + off, region(self, pos, (int64_t)len * sizeof(ctype)), len * sizeof(ctype)); \
+} \
+void \
+method_scala_Druntime_DMappedBuffer_Mput_Ascala_DLong_A_Nscala_D ## scalaname ## _Ascala_DInt_Ascala_DInt_Rscala_DUnit( \
+    struct java_lang_Object *self, vtable_t selfVtable, int64_t pos, \
+    struct array *src, vtable_t srcVtable, int32_t off, int32_t len) \
+{ \
+  checkslice(src, off, len); \
+  memcpy(writableregion(self, pos, (int64_t)len * sizeof(ctype)), ARRAY_DATA(src, ctype) + off, len * sizeof(ctype)); \
+}
+
+BULK_ACCESSORS(Byte, int8_t)
+BULK_ACCESSORS(Short, int16_t)
+BULK_ACCESSORS(Char, uint16_t)
+BULK_ACCESSORS(Int, int32_t)
+BULK_ACCESSORS(Long, int64_t)
+BULK_ACCESSORS(Float, float)
+BULK_ACCESSORS(Double, double)
+
+#undef BULK_ACCESSORS
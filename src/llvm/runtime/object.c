@@ -1,6 +1,7 @@
 #include "object.h"
 #include "strings.h"
 #include "runtime.h"
+#include "gc.h"
 
 struct java_lang_String;
 
@@ -12,15 +13,24 @@ static void *vtable_java_lang_Object[] = {
   method_java_Dlang_DObject_MtoString_Rjava_Dlang_DString,
 };
 
+extern struct klass class_java_Dlang_DObject_array;
+
 struct klass class_java_Dlang_DObject = {
   { sizeof("java.lang.Object")-1, "java.lang.Object" },
   sizeof(struct java_lang_Object),
   NULL,
   vtable_java_lang_Object,
+  &class_java_Dlang_DObject_array,
   NULL,
+  0,
+  0,
   NULL,
+  NULL,
+  0,
   0,
   0,
+  0,
+  { &class_java_Dlang_DObject },
 };
 
 int32_t
@@ -131,7 +141,7 @@ bool
 method_java_Dlang_DClass_MisArray_Rscala_DBoolean(
     struct java_lang_Class *self, vtable_t selfVtable)
 {
-  return self->theklass->elementklass != NULL;
+  return self->theklass->eltsize != 0;
 }
 
 bool
@@ -142,21 +152,24 @@ method_java_Dlang_DClass_MisAssignableFrom_Ajava_Dlang_DClass_Rscala_DBoolean(
   if (rt_issubclass(self->theklass, cls->theklass)) {
     return true;
   }
-  for (size_t i = 0; i < cls->theklass->numiface; ++i) {
-    if (cls->theklass->ifaces[i].klass == self->theklass) {
-      return true;
-    }
-  }
-  return false;
+  return rt_iface_lookup(cls->theklass, self->theklass) != NULL;
 }
 
-/* TODO - cache in klass struct */
+/* Class objects are immortal and cached in their klass, so there is one per
+ * klass and getClass does not allocate after the first call. */
 extern struct java_lang_Class *
 rt_classobject(struct klass* klass)
 {
-  struct java_lang_Class *klassobj = (struct java_lang_Class*)rt_new(&class_java_Dlang_DClass);
+  struct java_lang_Class *klassobj = klass->classobj;
+  if (klassobj != NULL) return klassobj;
+  klassobj = (struct java_lang_Class*)rt_new_immortal(&class_java_Dlang_DClass);
   method_java_Dlang_DObject_M_Linit_G_Rjava_Dlang_DObject((struct java_lang_Object*)klassobj, klassobj->super.klass->vtable);
   klassobj->theklass = klass;
+  /* if another thread got there first, use its object; ours stays immortal
+   * but unreferenced */
+  if (!__sync_bool_compare_and_swap(&klass->classobj, NULL, klassobj)) {
+    klassobj = klass->classobj;
+  }
   return klassobj;
 }
 
@@ -184,6 +197,14 @@ struct klass class_java_Dlang_DClass = {
   NULL,
   NULL,
   0,
+  0,
+  NULL,
+  NULL,
+  1,
+  0,
+  0,
+  0,
+  { &class_java_Dlang_DObject, &class_java_Dlang_DClass },
 };
 
 void *rt_boxedUnit_vtable[] = {
@@ -202,6 +223,14 @@ struct klass class_scala_Druntime_DBoxedUnit = {
   NULL,
   NULL,
   0,
+  0,
+  NULL,
+  NULL,
+  1,
+  0,
+  0,
+  0,
+  { &class_java_Dlang_DObject, &class_scala_Druntime_DBoxedUnit },
 };
 
 struct java_lang_Object rt_boxedUnit = {
@@ -18,26 +18,39 @@
 #include "llvm/PassManager.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/MutexGuard.h"
 #include "llvm/Support/PluginLoader.h"
 #include "llvm/Support/PrettyStackTrace.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/Format.h"
 #include "llvm/Support/InstIterator.h"
 #include "llvm/Instructions.h"
 #if LLVM_MAJOR_VERSION >=2 && LLVM_MINOR_VERSION >= 9
 # include "llvm/ADT/OwningPtr.h"
+# include "llvm/Support/Host.h"
 # include "llvm/Support/Process.h"
 # include "llvm/Support/Signals.h"
+# include "llvm/Support/Threading.h"
 # include "llvm/Support/system_error.h"
 #else
+# include "llvm/System/Host.h"
 # include "llvm/System/Process.h"
 # include "llvm/System/Signals.h"
+# include "llvm/System/Threading.h"
 #endif
 #include "llvm/Target/TargetSelect.h"
 #include "llvm/Target/TargetOptions.h"
 #include "llvm/Support/IRBuilder.h"
 #include <cerrno>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <unistd.h>
 #include <iostream>
+#include <map>
+#include <set>
+#include <vector>
+#include <pthread.h>
 
 #include "wrapper.h"
 
@@ -50,13 +63,20 @@ using namespace llvm;
 
 static ExecutionEngine *EE = 0;
 
+static void stopCompileAhead();
+
 static void do_shutdown() {
+  stopCompileAhead();
   delete EE;
   llvm_shutdown();
 }
 
 extern void* getExceptionObject;
 extern void* scalaPersonality;
+extern "C" void printExceptionTrace(void *uwx);
+extern "C" void registerScalaFunction(const char *name, void *start, size_t size);
+extern "C" void unregisterScalaFunction(void *start);
+extern "C" void tierup(void *f);
 
 static size_t nesting = 0;
 
@@ -78,6 +98,10 @@ static void *makeFuns(const std::string &name)
 {
   if (name == "createOurException") {
     return (void*)createOurException;
+  } else if (name == "deleteOurException") {
+    return (void*)deleteOurException;
+  } else if (name == "printExceptionTrace") {
+    return (void*)printExceptionTrace;
   } else if (name == "getExceptionObject") {
     return getExceptionObject;
   } else if (name == "scalaPersonality") {
@@ -86,6 +110,8 @@ static void *makeFuns(const std::string &name)
     return (void*)traceentry;
   } else if (name == "traceexit") {
     return (void*)traceexit;
+  } else if (name == "tierup") {
+    return (void*)tierup;
   } else {
     errs() << "Missing function " << name << "\n";
     return (void*)abort;
@@ -97,9 +123,11 @@ class LogFuns : public JITEventListener {
   void NotifyFunctionEmitted(const Function &F, void *Code, size_t Size, const EmittedFunctionDetails &details)
   {
     //std::cerr << "Emitted function " << F.getNameStr() << " to address range " << Code << " - " << (void*)(((char*)Code) + Size) << std::endl;
+    registerScalaFunction(F.getName().str().c_str(), Code, Size);
   }
   void NotifyFreeingMachineCode(void *OldPtr)
   {
+    unregisterScalaFunction(OldPtr);
   }
 };
 
@@ -142,6 +170,272 @@ void traceFuncs(Module &m)
   }
 }
 
+static double seconds(const sys::TimeValue &t)
+{
+  return t.seconds() + t.nanoseconds() / 1e9;
+}
+
+/* Tiered execution: functions start out unoptimized, with a call counter
+ * at their entry. The call that brings a counter to the threshold strips
+ * the counter, runs the function through the optimizing pipeline and has
+ * the JIT recompile it. The JIT patches the entry of the old code to jump
+ * to the new, so callers that already hold the old address, and frames
+ * still running in the old code, go on working. */
+
+struct TierCounter {
+  /* the counter update and test, in order; the last is the branch */
+  std::vector<Instruction*> insns;
+  BasicBlock *hot;
+  BasicBlock *body;
+};
+
+static std::map<Function*,TierCounter> tierCounters;
+static FunctionPassManager *tierPasses = 0;
+static unsigned tierRecompiled = 0;
+static double tierSeconds = 0;
+
+static void addCounter(Function *f, Constant *tierupFn, unsigned threshold)
+{
+  if (f->getBasicBlockList().empty()) return;
+  LLVMContext &ctx = f->getContext();
+  const Type *i32 = Type::getInt32Ty(ctx);
+  GlobalVariable *calls = new GlobalVariable(*f->getParent(), i32, false,
+      GlobalValue::InternalLinkage, ConstantInt::get(i32, 0), f->getName() + ".calls");
+  /* allocas stay in the entry block, where mem2reg looks for them */
+  BasicBlock *entry = &f->getEntryBlock();
+  BasicBlock::iterator ip = entry->begin();
+  while (isa<AllocaInst>(&*ip)) ++ip;
+  BasicBlock *body = entry->splitBasicBlock(ip, "tier.body");
+  entry->getTerminator()->eraseFromParent();
+  BasicBlock *hot = BasicBlock::Create(ctx, "tier.hot", f, body);
+
+  TierCounter tc;
+  IRBuilder<> builder(entry);
+  LoadInst *count = builder.CreateLoad(calls);
+  Value *next = builder.CreateAdd(count, ConstantInt::get(i32, 1));
+  StoreInst *store = builder.CreateStore(next, calls);
+  Value *isHot = builder.CreateICmpEQ(next, ConstantInt::get(i32, threshold));
+  BranchInst *branch = builder.CreateCondBr(isHot, hot, body);
+  tc.insns.push_back(count);
+  tc.insns.push_back(cast<Instruction>(next));
+  tc.insns.push_back(store);
+  tc.insns.push_back(cast<Instruction>(isHot));
+  tc.insns.push_back(branch);
+  tc.hot = hot;
+  tc.body = body;
+
+  builder.SetInsertPoint(hot);
+  const IntegerType *intptr = IntegerType::get(ctx, sizeof(void*) * 8);
+  builder.CreateCall(tierupFn, ConstantExpr::getIntToPtr(
+      ConstantInt::get(intptr, (uint64_t)(intptr_t)f), Type::getInt8PtrTy(ctx)));
+  builder.CreateBr(body);
+
+  tierCounters[f] = tc;
+}
+
+static void tierFuncs(Module &m, unsigned threshold)
+{
+  LLVMContext &ctx = m.getContext();
+  std::vector<const Type*> argtypes;
+  argtypes.push_back(Type::getInt8PtrTy(ctx));
+  FunctionType *tierupFnTy = FunctionType::get(Type::getVoidTy(ctx), argtypes, false);
+  Constant *tierupFn = m.getOrInsertFunction("tierup", tierupFnTy);
+  for (Module::iterator it = m.begin(); it != m.end(); ++it) {
+    addCounter(it, tierupFn, threshold);
+  }
+}
+
+extern "C" void tierup(void *fp)
+{
+  Function *f = (Function*)fp;
+  /* threads compiling ahead generate code from the same context, so the
+   * rewrite and recompile hold the JIT's lock throughout */
+  MutexGuard locked(EE->lock);
+  std::map<Function*,TierCounter>::iterator it = tierCounters.find(f);
+  if (it == tierCounters.end()) return;
+  TierCounter tc = it->second;
+  tierCounters.erase(it);
+
+  sys::TimeValue start = sys::TimeValue::now();
+  BasicBlock *entry = tc.insns.back()->getParent();
+  while (!tc.insns.empty()) {
+    tc.insns.back()->eraseFromParent();
+    tc.insns.pop_back();
+  }
+  BranchInst::Create(tc.body, entry);
+  tc.hot->eraseFromParent();
+  tierPasses->run(*f);
+  EE->recompileAndRelinkFunction(f);
+  tierRecompiled++;
+  tierSeconds += seconds(sys::TimeValue::now() - start);
+}
+
+/* Compiling ahead: with -jobs=N, N threads compile the functions the main
+ * wrapper can reach while the program runs, nearest first, so that calls
+ * rarely stop for the lazy compiler. Reaching a function counts direct
+ * calls and references through constants, such as vtables. The JIT has a
+ * single code generator behind its lock, so functions are still compiled
+ * one at a time; what runs in parallel is the program and the compiler,
+ * and more than one thread only adds contention for the lock. */
+
+static std::vector<Function*> aheadQueue;
+static size_t aheadNext = 0;
+static volatile bool aheadStop = false;
+static std::vector<pthread_t> aheadThreads;
+
+static void addReferenced(Value *v, std::vector<Function*> &queue, std::set<Value*> &seen)
+{
+  if (!isa<Constant>(v) || !seen.insert(v).second) return;
+  if (Function *f = dyn_cast<Function>(v)) {
+    if (!f->isDeclaration()) queue.push_back(f);
+  } else if (GlobalVariable *gv = dyn_cast<GlobalVariable>(v)) {
+    if (gv->hasInitializer()) addReferenced(gv->getInitializer(), queue, seen);
+  } else if (!isa<GlobalValue>(v)) {
+    User *u = cast<User>(v);
+    for (User::op_iterator op = u->op_begin(); op != u->op_end(); ++op) {
+      addReferenced(*op, queue, seen);
+    }
+  }
+}
+
+/* breadth first from root, which the main thread compiles itself */
+static void orderCompileAhead(Function *root)
+{
+  std::set<Value*> seen;
+  seen.insert(root);
+  aheadQueue.push_back(root);
+  for (size_t i = 0; i < aheadQueue.size(); i++) {
+    for (inst_iterator I = inst_begin(aheadQueue[i]), E = inst_end(aheadQueue[i]); I != E; ++I) {
+      for (User::op_iterator op = I->op_begin(); op != I->op_end(); ++op) {
+        addReferenced(*op, aheadQueue, seen);
+      }
+    }
+  }
+  aheadQueue.erase(aheadQueue.begin());
+}
+
+static void *compileAhead(void *arg)
+{
+  while (!aheadStop) {
+    size_t i = __sync_fetch_and_add(&aheadNext, 1);
+    if (i >= aheadQueue.size()) break;
+    /* does nothing for functions the program already called */
+    EE->getPointerToFunction(aheadQueue[i]);
+  }
+  return NULL;
+}
+
+static void startCompileAhead(Function *root, unsigned jobs)
+{
+  orderCompileAhead(root);
+  errs() << "Compiling " << aheadQueue.size() << " functions ahead on " << jobs << " threads\n";
+  for (unsigned i = 0; i < jobs; i++) {
+    pthread_t t;
+    if (pthread_create(&t, NULL, compileAhead, NULL) != 0) break;
+    aheadThreads.push_back(t);
+  }
+}
+
+/* waits for the functions being compiled, and compiles no more */
+static void stopCompileAhead()
+{
+  aheadStop = true;
+  for (size_t i = 0; i < aheadThreads.size(); i++) {
+    pthread_join(aheadThreads[i], NULL);
+  }
+  aheadThreads.clear();
+}
+
+/* Optimized program cache: with -cache=dir, the optimized module is saved
+ * as bitcode under a key made from the input bitcode, the opt level and
+ * the host, the LLVM version and the runscala build, and with -lto the
+ * runtime archive, and later runs with the same key load it instead of
+ * running the optimizer again. A cache file that fails to load is ignored. The JIT cannot load native code, so a warm run
+ * still generates code. Any change to the input changes the key. */
+
+#define CACHE_FORMAT 1
+
+static MemoryBuffer *readFile(const char *path, std::string *err)
+{
+#if LLVM_MAJOR_VERSION >= 2 && LLVM_MINOR_VERSION >= 9
+  OwningPtr<MemoryBuffer> buffer;
+  error_code errc = MemoryBuffer::getFileOrSTDIN(path, buffer);
+  if (errc) {
+    *err = errc.message();
+    return NULL;
+  }
+  return buffer.take();
+#else
+  return MemoryBuffer::getFileOrSTDIN(path, err);
+#endif
+}
+
+/* 64-bit FNV-1a */
+static uint64_t hashBytes(uint64_t h, const char *p, size_t n)
+{
+  for (size_t i = 0; i < n; i++) {
+    h ^= (unsigned char)p[i];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+static std::string cachePath(const std::string &dir, const MemoryBuffer *program, unsigned level,
+                             const MemoryBuffer *runtime)
+{
+  std::string host = sys::getHostTriple();
+  uint64_t h = 14695981039346656037ULL;
+  h = hashBytes(h, program->getBufferStart(), program->getBufferSize());
+  if (runtime) h = hashBytes(h, runtime->getBufferStart(), runtime->getBufferSize());
+  h = hashBytes(h, host.data(), host.size());
+  /* a rebuilt optimizer or LLVM may produce different code */
+  std::string build;
+  build += LLVM_VERSION_STRING;
+  build += " ";
+  build += optimizeBuildId;
+  build += " " __DATE__ " " __TIME__;
+  h = hashBytes(h, build.data(), build.size());
+  unsigned tag[2] = { CACHE_FORMAT, level };
+  h = hashBytes(h, (const char*)tag, sizeof(tag));
+  std::string path;
+  raw_string_ostream os(path);
+  os << dir << "/" << format("%016llx", (unsigned long long)h) << ".bc";
+  return os.str();
+}
+
+/* written under a temporary name and renamed, so a concurrent run never
+ * sees half a file */
+static void writeCache(Module &m, const std::string &path)
+{
+  std::string tmp;
+  raw_string_ostream tmpos(tmp);
+  tmpos << path << "." << (unsigned)getpid() << ".tmp";
+  tmpos.flush();
+  std::string err;
+  {
+    raw_fd_ostream out(tmp.c_str(), err, raw_fd_ostream::F_Binary);
+    if (!err.empty()) {
+      errs() << "Cannot write program cache " << tmp << ": " << err << "\n";
+      return;
+    }
+    WriteBitcodeToFile(&m, out);
+  }
+  if (rename(tmp.c_str(), path.c_str()) != 0) {
+    errs() << "Cannot write program cache " << path << ": " << strerror(errno) << "\n";
+    unlink(tmp.c_str());
+  }
+}
+
+static void usage(const char *argv0)
+{
+  errs() << "usage: " << argv0 << " [-O0|-O1|-O2|-O3] [-tiered[=calls]] [-cache=dir] [-lto] [-rt=dir] [-jobs[=N]]"
+         << " program.bc module [args...]\n"
+         << "  -jobs[=N]  compile ahead on N threads (default 1) while the program runs;\n"
+         << "             code generation is serialized, so this overlaps compiling with\n"
+         << "             running rather than spreading compilation across cores\n";
+  exit(1);
+}
+
 int main(int argc, char *argv[], char * const *envp)
 {
   sys::PrintStackTraceOnErrorSignal();
@@ -155,37 +449,112 @@ int main(int argc, char *argv[], char * const *envp)
   std::string ErrorMsg;
   Module *Mod = NULL;
 
-#if LLVM_MAJOR_VERSION >= 2 && LLVM_MINOR_VERSION >= 9
-  OwningPtr<MemoryBuffer> Buffer;
-  error_code errc = MemoryBuffer::getFileOrSTDIN(argv[1], Buffer);
-  if (errc) {
-    errs() << argv[0] << ": error load program '" << argv[1] << "': " << errc.message() << "\n";
-    exit(1);
-  } else {
-    Mod = getLazyBitcodeModule(Buffer.get(), Context, &ErrorMsg);
+  /* options come before the program; everything after the module name
+   * belongs to the program */
+  unsigned OptLevel = 0;
+  /* with tiering, calls before a function is recompiled; 0 for none */
+  unsigned TierThreshold = 0;
+  std::string CacheDir;
+  /* whole program: the runtime's bitcode is linked in if the program
+   * lacks it, and everything but the entry points is made internal */
+  bool LTO = false;
+  std::string RuntimeDir;
+  /* threads compiling ahead of the program; 0 for lazy compilation only */
+  unsigned Jobs = 0;
+  int argi = 1;
+  for (; argi < argc && argv[argi][0] == '-'; argi++) {
+    const char *opt = argv[argi];
+    if (opt[1] == 'O' && opt[2] >= '0' && opt[2] <= '3' && opt[3] == 0) {
+      OptLevel = opt[2] - '0';
+    } else if (strcmp(opt, "-tiered") == 0) {
+      TierThreshold = 1000;
+    } else if (strncmp(opt, "-tiered=", 8) == 0 && atoi(opt + 8) > 0) {
+      TierThreshold = atoi(opt + 8);
+    } else if (strncmp(opt, "-cache=", 7) == 0 && opt[7] != 0) {
+      CacheDir = opt + 7;
+    } else if (strcmp(opt, "-lto") == 0) {
+      LTO = true;
+    } else if (strncmp(opt, "-rt=", 4) == 0) {
+      RuntimeDir = opt + 4;
+    } else if (strcmp(opt, "-jobs") == 0) {
+      Jobs = 1;
+    } else if (strncmp(opt, "-jobs=", 6) == 0 && atoi(opt + 6) > 0) {
+      Jobs = atoi(opt + 6);
+    } else {
+      errs() << argv[0] << ": unknown option '" << opt << "'\n";
+      usage(argv[0]);
+    }
   }
-  if (!Mod) {
-    errs() << argv[0] << ": error loading program '" << argv[1] << "': "
-           << ErrorMsg << "\n";
+  if (argc - argi < 2) usage(argv[0]);
+  if (Jobs > 0 && !llvm_start_multithreaded()) {
+    errs() << argv[0] << ": LLVM was built without threads, compiling lazily\n";
+    Jobs = 0;
+  }
+  const char *ProgramFile = argv[argi];
+  const char *ProgramModule = argv[argi+1];
+  if (RuntimeDir.empty()) {
+    std::string self(argv[0]);
+    size_t slash = self.find_last_of('/');
+    RuntimeDir = slash == std::string::npos ? "." : self.substr(0, slash);
+  }
+  std::string RuntimeArchive = RuntimeDir + "/llvmrt.a";
+
+  MemoryBuffer *Buffer = readFile(ProgramFile, &ErrorMsg);
+  if (!Buffer) {
+    errs() << argv[0] << ": error load program '" << ProgramFile << "': " << ErrorMsg << "\n";
     exit(1);
   }
-#else
-  if (MemoryBuffer *Buffer = MemoryBuffer::getFileOrSTDIN(argv[1],&ErrorMsg)) {
-    Mod = getLazyBitcodeModule(Buffer, Context, &ErrorMsg);
-    if (!Mod) delete Buffer;
+
+  /* only optimized, uninstrumented programs are cached */
+  std::string CacheFile;
+  bool Cached = false;
+  if (!CacheDir.empty() && OptLevel > 0 && TierThreshold == 0) {
+    MemoryBuffer *Runtime = NULL;
+    if (LTO && !(Runtime = readFile(RuntimeArchive.c_str(), &ErrorMsg))) {
+      errs() << argv[0] << ": error loading runtime '" << RuntimeArchive << "': " << ErrorMsg << "\n";
+      exit(1);
+    }
+    CacheFile = cachePath(CacheDir, Buffer, OptLevel, Runtime);
+    delete Runtime;
+    std::string CacheErr;
+    if (access(CacheFile.c_str(), R_OK) == 0) {
+      /* read completely, so a damaged file is found before it is used */
+      if (MemoryBuffer *CacheBuffer = readFile(CacheFile.c_str(), &CacheErr)) {
+        Mod = getLazyBitcodeModule(CacheBuffer, Context, &CacheErr);
+        if (!Mod) {
+          delete CacheBuffer;
+        } else if (Mod->MaterializeAll(&CacheErr)) {
+          delete Mod;
+          Mod = NULL;
+        }
+      }
+      if (Mod) {
+        errs() << "Using cached program " << CacheFile << "\n";
+        delete Buffer;
+        Cached = true;
+      } else {
+        errs() << "Ignoring program cache " << CacheFile << ": " << CacheErr << "\n";
+      }
+    }
   }
+
   if (!Mod) {
-    errs() << argv[0] << ": error loading program '" << argv[1] << "': "
-           << ErrorMsg << "\n";
-    exit(1);
+    Mod = getLazyBitcodeModule(Buffer, Context, &ErrorMsg);
+    if (!Mod) {
+      delete Buffer;
+      errs() << argv[0] << ": error loading program '" << ProgramFile << "': "
+             << ErrorMsg << "\n";
+      exit(1);
+    }
   }
-#endif
 
 
   EngineBuilder builder(Mod);
   builder.setErrorStr(&ErrorMsg);
   builder.setEngineKind(EngineKind::JIT);
-  builder.setOptLevel(CodeGenOpt::None);
+  /* the JIT has one code generator, so in tiered mode it stays fast and
+   * only the IR of hot functions is optimized */
+  builder.setOptLevel(TierThreshold > 0 ? CodeGenOpt::None : codeGenOptLevel(OptLevel));
   //builder.setUseMCJIT(true);
 
   EE = builder.create();
@@ -201,7 +570,7 @@ int main(int argc, char *argv[], char * const *envp)
   EE->DisableLazyCompilation(false);
   EE->RegisterJITEventListener(new LogFuns());
 
-  std::string modid(argv[2]);
+  std::string modid(ProgramModule);
 
   std::string modulename;
   modulename += "module__O";
@@ -241,12 +610,38 @@ int main(int argc, char *argv[], char * const *envp)
   // Run static constructors.
   EE->runStaticConstructorsDestructors(false);
 
+  std::vector<const char*> Exports;
+  Exports.push_back(mainfnname.c_str());
+  Exports.push_back(moduleinitfnname.c_str());
+  Exports.push_back(modulename.c_str());
+  addMainWrapperExports(Exports);
+
   std::vector<GenericValue> args;
 
   errs() << "Materializing\n";
 
   Mod->MaterializeAll();
+  if (LTO && !Cached && !linkRuntime(Mod, RuntimeArchive, &ErrorMsg)) {
+    errs() << argv[0] << ": error linking runtime '" << RuntimeArchive << "': " << ErrorMsg << "\n";
+    exit(1);
+  }
   traceFuncs(*Mod);
+  if (TierThreshold > 0) {
+    /* only the whole-program passes; hot functions are optimized later */
+    if (LTO) optimizeModule(*Mod, 0, EE->getTargetData(), &Exports);
+    tierFuncs(*Mod, TierThreshold);
+    tierPasses = new FunctionPassManager(Mod);
+    addFunctionPasses(*tierPasses, OptLevel > 0 ? OptLevel : 2, EE->getTargetData());
+    tierPasses->doInitialization();
+  }
+
+  sys::TimeValue optStart = sys::TimeValue::now();
+  if ((OptLevel > 0 || LTO) && TierThreshold == 0 && !Cached) {
+    errs() << "Optimizing at -O" << OptLevel << (LTO ? " with the runtime" : "") << "\n";
+    optimizeModule(*Mod, OptLevel, EE->getTargetData(), LTO ? &Exports : NULL);
+    if (!CacheFile.empty()) writeCache(*Mod, CacheFile);
+  }
+  sys::TimeValue optEnd = sys::TimeValue::now();
 
   errs() << "Creating main wrapper\n";
   
@@ -257,11 +652,20 @@ int main(int argc, char *argv[], char * const *envp)
   args.clear();
 
   std::vector<std::string> jitargv;
-  for (int i = 3; i < argc; i++) {
+  for (int i = argi + 2; i < argc; i++) {
     jitargv.push_back(std::string(argv[i]));
   }
+  if (Jobs > 0) startCompileAhead(wrapper, Jobs);
   errs() << "Running main function\n";
   EE->runFunctionAsMain(wrapper, jitargv, envp);
+  sys::TimeValue runEnd = sys::TimeValue::now();
+  stopCompileAhead();
+
+  errs() << format("Optimizing took %.3fs, running %.3fs (including code generation)\n",
+                   seconds(optEnd - optStart), seconds(runEnd - optEnd));
+  if (TierThreshold > 0) {
+    errs() << format("Recompiled %u hot functions in %.3fs\n", tierRecompiled, tierSeconds);
+  }
 
   errs() << "Running static destructors\n";
   EE->runStaticConstructorsDestructors(true);
@@ -1,11 +1,15 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "klass.h"
 #include "object.h"
 #include "runtime.h"
 #include "arrays.h"
 #include "strings.h"
+#include "gc.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 #include <unicode/ustring.h>
 #include <unicode/utypes.h>
 
@@ -24,19 +28,80 @@ void rt_delete(struct java_lang_Object *object)
   if (object != NULL) free(object);
 }
 
+/* Interface Tables
+ *
+ * Each class lazily gets an open addressing table mapping interface klass to
+ * interface vtable, built from ifaces[] and kept at most half full, so an
+ * interface lookup is a hash and usually a single probe no matter how many
+ * traits the class mixes in. */
+
+static inline uint32_t
+ifacehash(struct klass *iface)
+{
+  return (uint32_t)(((uint64_t)(uintptr_t)iface * UINT64_C(0x9E3779B97F4A7C15)) >> 32);
+}
+
+static uint32_t nextifaceid = 0;
+
+/* Building a class's table also gives each of its interfaces an id, so an
+ * interface without one is implemented by no class that has a table yet. */
+static struct itable*
+builditable(struct klass *klass)
+{
+  uint32_t cap = 2;
+  uint32_t nbits = 0;
+  while (cap < klass->numiface * 2) cap <<= 1;
+  for (uint32_t n = 0; n < klass->numiface; n++) {
+    struct klass *iface = klass->ifaces[n].klass;
+    if (iface->ifaceid == 0) iface->ifaceid = ++nextifaceid;
+    if (iface->ifaceid >= nbits) nbits = iface->ifaceid + 1;
+  }
+  size_t nwords = (nbits + 63) / 64;
+  size_t slotsize = sizeof(struct itable) + cap * sizeof(struct ifaceinfo);
+  struct itable *t = calloc(1, slotsize + nwords * sizeof(uint64_t));
+  if (t == NULL) {
+    fprintf(stderr, "Out of memory building itable\n");
+    abort();
+  }
+  t->mask = cap - 1;
+  t->nbits = nbits;
+  t->ifacebits = (uint64_t*)((char*)t + slotsize);
+  for (uint32_t n = 0; n < klass->numiface; n++) {
+    uint32_t id = klass->ifaces[n].klass->ifaceid;
+    uint32_t i = ifacehash(klass->ifaces[n].klass) & t->mask;
+    while (t->slots[i].klass != NULL) i = (i + 1) & t->mask;
+    t->slots[i] = klass->ifaces[n];
+    t->ifacebits[id / 64] |= UINT64_C(1) << (id % 64);
+  }
+  klass->itable = t;
+  return t;
+}
+
+static inline struct itable*
+itablefor(struct klass *klass)
+{
+  if (klass->itable != NULL) return klass->itable;
+  if (klass->numiface == 0) return NULL;
+  return builditable(klass);
+}
+
+void **rt_iface_lookup(struct klass *klass, struct klass *iface)
+{
+  struct itable *t = itablefor(klass);
+  if (t == NULL) return NULL;
+  for (uint32_t i = ifacehash(iface) & t->mask; ; i = (i + 1) & t->mask) {
+    if (t->slots[i].klass == iface) return t->slots[i].vtable;
+    if (t->slots[i].klass == NULL) return NULL;
+  }
+}
+
 void **rt_iface_cast(struct java_lang_Object *object, struct klass *iface)
 {
   //fprintf(stderr, "rt_iface_cast(%p, %p)\n", object, iface);
   if (object == NULL) return NULL;
   struct klass *klass = object->klass;
-  void **vtable = NULL;
-  uint32_t i;
+  void **vtable = rt_iface_lookup(klass, iface);
   //fprintf(stderr, "Casting %p %.*s to %p %.*s\n", object, klass->name.len, klass->name.bytes, iface, iface->name.len, iface->name.bytes);
-  for (i = 0; i < klass->numiface; i++) {
-    if (klass->ifaces[i].klass == iface) {
-      vtable = klass->ifaces[i].vtable;
-    }
-  }
   if (vtable != NULL) {
     return vtable;
   } else {
@@ -45,6 +110,63 @@ void **rt_iface_cast(struct java_lang_Object *object, struct klass *iface)
   }
 }
 
+/* Inline Caches
+ *
+ * A cache starts empty, becomes monomorphic on its first miss and polymorphic
+ * on its second, and goes megamorphic once a miss finds all ICACHE_WAYS
+ * entries taken; after that it only counts. Caches that have missed are
+ * linked together so that setting SCALA_ICACHE_STATS dumps per-site hit and
+ * miss counts at exit. */
+
+static struct icache *icaches = NULL;
+
+static const char *icachestates[] = { "empty", "monomorphic", "polymorphic", "megamorphic" };
+
+static void
+dumpicaches()
+{
+  for (struct icache *c = icaches; c != NULL; c = c->next) {
+    fprintf(stderr, "icache %s: %s, %llu hits, %llu misses\n", c->site,
+        icachestates[c->state], (unsigned long long)c->hits, (unsigned long long)c->misses);
+  }
+}
+
+static void **
+icachemiss(struct java_lang_Object *object, struct klass *iface, struct icache *cache)
+{
+  void **vtable = rt_iface_cast(object, iface);
+  cache->misses++;
+  if (cache->state == ICACHE_EMPTY) {
+    if (icaches == NULL && getenv("SCALA_ICACHE_STATS") != NULL) {
+      atexit(dumpicaches);
+    }
+    cache->next = icaches;
+    icaches = cache;
+  }
+  if (cache->used < ICACHE_WAYS) {
+    cache->entries[cache->used].klass = object->klass;
+    cache->entries[cache->used].vtable = vtable;
+    cache->used++;
+    cache->state = cache->used == 1 ? ICACHE_MONOMORPHIC : ICACHE_POLYMORPHIC;
+  } else {
+    cache->state = ICACHE_MEGAMORPHIC;
+  }
+  return vtable;
+}
+
+void **rt_iface_cast_cached(struct java_lang_Object *object, struct klass *iface, struct icache *cache)
+{
+  if (object == NULL) return NULL;
+  struct klass *klass = object->klass;
+  for (uint32_t i = 0; i < cache->used; i++) {
+    if (cache->entries[i].klass == klass) {
+      cache->hits++;
+      return cache->entries[i].vtable;
+    }
+  }
+  return icachemiss(object, iface, cache);
+}
+
 bool rt_isinstance(struct java_lang_Object *object, struct klass *classoriface)
 {
   bool res;
@@ -58,21 +180,23 @@ bool rt_isinstance(struct java_lang_Object *object, struct klass *classoriface)
 bool rt_issubclass(struct klass *super, struct klass *sub)
 {
   if (super == sub) return true;
-  if (super->instsize == 0 && sub->instsize == 0) {
-    if ((super->elementklass != NULL) && (sub->elementklass != NULL)) {
-      super = super->elementklass;
-      sub = sub->elementklass;
-    }
+  /* arrays of references are covariant, at any depth */
+  while (super->instsize == 0 && sub->instsize == 0 &&
+         super->eltisref && sub->eltisref) {
+    super = super->elementklass;
+    sub = sub->elementklass;
+    if (super == sub) return true;
+  }
+  if (sub->depth < super->depth) return false;
+  if (super->depth < DISPLAY_SIZE) {
+    /* Cohen display: the ancestor at super's depth must be super */
+    return sub->display[super->depth] == super;
   }
   struct klass *checkclass = sub;
-  while (checkclass != NULL) {
-    if (super == checkclass) {
-      return true;
-    } else {
-      checkclass = checkclass->super;
-    }
+  for (uint32_t d = sub->depth; d > super->depth; d--) {
+    checkclass = checkclass->super;
   }
-  return false;
+  return checkclass == super;
 }
 
 bool rt_isinstance_class(struct java_lang_Object *object, struct klass *klass)
@@ -82,14 +206,19 @@ bool rt_isinstance_class(struct java_lang_Object *object, struct klass *klass)
 
 bool rt_isinstance_iface(struct java_lang_Object *object, struct klass *iface)
 {
-  struct klass *klass = object->klass;
-  uint32_t i;
-  for (i = 0; i < klass->numiface; i++) {
-    if (klass->ifaces[i].klass == iface) {
-      return true;
-    }
-  }
-  return false;
+  struct itable *t = itablefor(object->klass);
+  uint32_t id = iface->ifaceid;
+  if (t == NULL || id >= t->nbits) return false;
+  return (t->ifacebits[id / 64] >> (id % 64)) & 1;
+}
+
+int64_t
+method__Ojava_Dlang_DSystem_MnanoTime_Rscala_DLong(
+    struct java_lang_Object *self, vtable_t selfVtable)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
 }
 
 void rt_init_loop()
@@ -104,15 +233,45 @@ extern void
 method_java_Dlang_DNullPointerException_M_Linit_G_Rjava_Dlang_DNullPointerException(
     struct java_lang_Object *self, vtable_t selfVtable);
 
+/* Throwing
+ *
+ * The unwind header wrapped around a thrown object comes from a per-thread
+ * pool in unwind.cpp and goes back to it when a handler catches it. The
+ * exceptions the runtime raises for null references and bad indices carry
+ * no state, so each is thrown from a single immortal instance made on first
+ * use, and raising one allocates nothing. */
+
+void rt_throw(struct java_lang_Object *exception)
+{
+  _Unwind_RaiseException(createOurException(exception));
+  __builtin_unreachable();
+}
+
+void rt_throw_new(struct klass *klass, void (*init)(struct java_lang_Object *, vtable_t))
+{
+  struct java_lang_Object *exception = rt_new(klass);
+  init(exception, rt_loadvtable(exception));
+  rt_throw(exception);
+}
+
+void rt_throw_preallocated(struct java_lang_Object **slot, struct klass *klass,
+    void (*init)(struct java_lang_Object *, vtable_t))
+{
+  struct java_lang_Object *exception = *slot;
+  if (exception == NULL) {
+    exception = rt_new_immortal(klass);
+    init(exception, rt_loadvtable(exception));
+    *slot = exception;
+  }
+  rt_throw(exception);
+}
+
 void rt_assertNotNull(struct java_lang_Object *object)
 {
+  static struct java_lang_Object *npe = NULL;
   if (object == NULL) {
-    struct java_lang_Object *exception = rt_new(&class_java_Dlang_DNullPointerException);
-    void *uwx;
-    method_java_Dlang_DNullPointerException_M_Linit_G_Rjava_Dlang_DNullPointerException(exception, rt_loadvtable(exception));
-    uwx = createOurException(exception);
-    _Unwind_RaiseException(uwx);
-    __builtin_unreachable();
+    rt_throw_preallocated(&npe, &class_java_Dlang_DNullPointerException,
+        method_java_Dlang_DNullPointerException_M_Linit_G_Rjava_Dlang_DNullPointerException);
   }
 }
 
@@ -120,24 +279,18 @@ typedef struct java_lang_Object* (*toStringFn)(struct java_lang_Object *, vtable
 
 void rt_printexception(struct java_lang_Object *object)
 {
+  rt_flushoutput();
   fprintf(stderr, "Uncaught exception: %.*s\n", object->klass->name.len, object->klass->name.bytes);
   toStringFn toString;
   toString = object->klass->vtable[4];
   vtable_t tempVtable;
   struct java_lang_String *ss;
   ss = (struct java_lang_String*)toString(object, rt_loadvtable(object), &tempVtable);
-  int32_t bufreq;
-  UErrorCode err = U_ZERO_ERROR;
-  u_strToUTF8(NULL, 0, &bufreq, ss->s, ss->len, &err);
-  if (U_SUCCESS(err) || err == U_BUFFER_OVERFLOW_ERROR) {
-    err = U_ZERO_ERROR;
-    int32_t buflen = bufreq+1;
-    char u8buf[buflen];
-    u_strToUTF8(u8buf, buflen, NULL, ss->s, ss->len, &err);
-    if (U_SUCCESS(err)) {
-      u8buf[buflen-1] = 0;
-      fputs(u8buf, stderr);
-    }
+  int32_t buflen;
+  char *u8buf;
+  if (rt_stringtoutf8(ss, &u8buf, &buflen)) {
+    fwrite(u8buf, 1, buflen, stderr);
+    free(u8buf);
   }
 }
 
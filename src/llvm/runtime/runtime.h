@@ -15,6 +15,30 @@ extern struct java_lang_Object* rt_new(struct klass *klass);
 extern void rt_initobj(struct java_lang_Object *object, struct klass *klass);
 extern void rt_delete(struct java_lang_Object *object);
 extern vtable_t rt_iface_cast(struct java_lang_Object *object, struct klass *iface);
+extern vtable_t rt_iface_lookup(struct klass *klass, struct klass *iface);
+
+/* Per call site interface cast cache, allocated by GenLLVM and mirrored by
+ * Runtime.rtIcache there. Entries are keyed on the receiver's class. */
+#define ICACHE_WAYS 4
+
+enum icachestate {
+  ICACHE_EMPTY,
+  ICACHE_MONOMORPHIC,
+  ICACHE_POLYMORPHIC,
+  ICACHE_MEGAMORPHIC
+};
+
+struct icache {
+  uint32_t state;
+  uint32_t used;
+  uint64_t hits;
+  uint64_t misses;
+  struct icache *next;
+  const char *site;
+  struct ifaceinfo entries[ICACHE_WAYS];
+};
+
+extern vtable_t rt_iface_cast_cached(struct java_lang_Object *object, struct klass *iface, struct icache *cache);
 extern bool rt_issubclass(struct klass *super, struct klass *sub);
 extern bool rt_isinstance(struct java_lang_Object *object, struct klass *classoriface);
 extern bool rt_isinstance_class(struct java_lang_Object *object, struct klass *klass);
@@ -22,8 +46,15 @@ extern bool rt_isinstance_iface(struct java_lang_Object *object, struct klass *i
 extern void rt_init_loop();
 extern void rt_assertNotNull(struct java_lang_Object *object);
 extern vtable_t rt_loadvtable(struct java_lang_Object *object);
+extern void rt_flushoutput();
 
 extern void* createOurException(struct java_lang_Object *obj);
+extern void deleteOurException(void *uwx);
+extern void rt_throw(struct java_lang_Object *exception) __attribute__((noreturn));
+extern void rt_throw_new(struct klass *klass,
+    void (*init)(struct java_lang_Object *, vtable_t)) __attribute__((noreturn));
+extern void rt_throw_preallocated(struct java_lang_Object **slot, struct klass *klass,
+    void (*init)(struct java_lang_Object *, vtable_t)) __attribute__((noreturn));
 
 extern int32_t _Unwind_RaiseException(void*);
 
@@ -2,6 +2,7 @@
 #include "object.h"
 #include "runtime.h"
 #include "arrays.h"
+#include "gc.h"
 
 #include <unicode/ustdio.h>
 #include <unicode/unum.h>
@@ -13,15 +14,14 @@
 
 /* String Constants */
 
-U_STRING_DECL(u_TRUE_s, "true", 4);
-static bool u_TRUE_initted = false;
-U_STRING_DECL(u_FALSE_s, "false", 5);
-static bool u_FALSE_initted = false;
+static uint8_t l_TRUE_s[] = "true";
+static uint8_t l_FALSE_s[] = "false";
 
 struct stringlist {
   struct stringlist *prev;
   int32_t len;
-  UChar *s;
+  int32_t coder;
+  union stringchars chars;
 };
 
 static void *vtable_java_lang_String[] = {
@@ -32,15 +32,24 @@ static void *vtable_java_lang_String[] = {
   method_java_Dlang_DString_MtoString_Rjava_Dlang_DString,
 };
 
+extern struct klass class_java_Dlang_DString_array;
+
 struct klass class_java_Dlang_DString = {
   { sizeof("java.lang.String") - 1, "java.lang.String" },
   sizeof(struct java_lang_String),
   &class_java_Dlang_DObject,
   vtable_java_lang_String,
+  &class_java_Dlang_DString_array,
+  NULL,
+  0,
+  0,
   NULL,
   NULL,
+  1,
+  0,
   0,
   0,
+  { &class_java_Dlang_DObject, &class_java_Dlang_DString },
 };
 
 void
@@ -50,38 +59,317 @@ method_java_Dlang_DString_M_Linit_G_Rjava_Dlang_DString(
   method_java_Dlang_DObject_M_Linit_G_Rjava_Dlang_DObject(self, selfVtable);
 }
 
-struct java_lang_String*
-rt_stringcreate(UChar *buffer, int32_t len)
+static struct java_lang_String*
+stringinit(struct java_lang_String *ret, int32_t coder, union stringchars chars, int32_t len)
 {
-  struct java_lang_String *ret = (struct java_lang_String*)rt_new(&class_java_Dlang_DString);
   method_java_Dlang_DString_M_Linit_G_Rjava_Dlang_DString((struct java_lang_Object*)ret, rt_loadvtable((struct java_lang_Object*)ret));
   ret->len = len;
-  ret->s = buffer;
+  ret->coder = coder;
+  ret->chars = chars;
   return ret;
 }
 
+/* Compact Strings */
+
+static bool
+fitslatin1(const UChar *s, int32_t len)
+{
+  for (int32_t i = 0; i < len; i++) {
+    if (s[i] > 0xFF) return false;
+  }
+  return true;
+}
+
+static void
+narrowlatin1(uint8_t *dst, const UChar *s, int32_t len)
+{
+  for (int32_t i = 0; i < len; i++) {
+    dst[i] = (uint8_t)s[i];
+  }
+}
+
+static void
+widenlatin1(UChar *dst, const uint8_t *s, int32_t len)
+{
+  for (int32_t i = 0; i < len; i++) {
+    dst[i] = s[i];
+  }
+}
+
+static bool
+isascii7(const char *s, int32_t len)
+{
+  for (int32_t i = 0; i < len; i++) {
+    if ((uint8_t)s[i] >= 0x80) return false;
+  }
+  return true;
+}
+
+/* takes ownership of buffer, replacing it with a Latin-1 copy if possible */
+static struct java_lang_String*
+stringinitutf16(struct java_lang_String *ret, UChar *buffer, int32_t len)
+{
+  union stringchars chars;
+  if (COMPACT_STRINGS && fitslatin1(buffer, len)) {
+    chars.latin1 = malloc(len);
+    narrowlatin1(chars.latin1, buffer, len);
+    free(buffer);
+    return stringinit(ret, CODER_LATIN1, chars, len);
+  } else {
+    chars.utf16 = buffer;
+    return stringinit(ret, CODER_UTF16, chars, len);
+  }
+}
+
 struct java_lang_String*
-rt_makestring(struct utf8str *s)
+rt_stringcreate(UChar *buffer, int32_t len)
+{
+  return stringinitutf16((struct java_lang_String*)rt_new(&class_java_Dlang_DString), buffer, len);
+}
+
+static bool
+utf8toutf16(const char *bytes, int32_t len, UChar **out, int32_t *outlen)
 {
   enum UErrorCode uerr = U_ZERO_ERROR;
   UChar *buffer;
-  int32_t bufsize = s->len;
+  int32_t bufsize = len;
   int32_t reqsize;
   buffer = malloc(bufsize * sizeof(UChar));
-  u_strFromUTF8(buffer, bufsize, &reqsize, s->bytes, s->len, &uerr);
+  u_strFromUTF8(buffer, bufsize, &reqsize, bytes, len, &uerr);
   if (uerr == U_BUFFER_OVERFLOW_ERROR) {
     /* reallocate buffer and retry */
     free(buffer);
     buffer = malloc(reqsize * sizeof(UChar));
     bufsize = reqsize;
     uerr = U_ZERO_ERROR;
-    u_strFromUTF8(buffer, bufsize, &reqsize, s->bytes, s->len, &uerr);
+    u_strFromUTF8(buffer, bufsize, &reqsize, bytes, len, &uerr);
   }
   if (U_SUCCESS(uerr)) {
-    return rt_stringcreate(buffer, reqsize);
+    *out = buffer;
+    *outlen = reqsize;
+    return true;
   } else {
-    return NULL;
+    free(buffer);
+    return false;
+  }
+}
+
+static bool
+utf16toutf8(const UChar *s, int32_t len, char **out, int32_t *outlen)
+{
+  enum UErrorCode uerr = U_ZERO_ERROR;
+  char *buffer;
+  int32_t bufsize = len;
+  int32_t reqsize;
+  buffer = malloc(bufsize * sizeof(char));
+  u_strToUTF8(buffer, bufsize, &reqsize, s, len, &uerr);
+  if (uerr == U_BUFFER_OVERFLOW_ERROR) {
+    /* reallocate buffer and retry */
+    free(buffer);
+    buffer = malloc(reqsize * sizeof(char));
+    bufsize = reqsize;
+    uerr = U_ZERO_ERROR;
+    u_strToUTF8(buffer, bufsize, &reqsize, s, len, &uerr);
+  }
+  if (U_SUCCESS(uerr)) {
+    *out = buffer;
+    *outlen = reqsize;
+    return true;
+  } else {
+    free(buffer);
+    return false;
+  }
+}
+
+static int32_t
+latin1utf8len(const uint8_t *s, int32_t len)
+{
+  int32_t reqsize = len;
+  for (int32_t i = 0; i < len; i++) {
+    if (s[i] >= 0x80) reqsize++;
+  }
+  return reqsize;
+}
+
+static void
+latin1toutf8(char *dst, const uint8_t *s, int32_t len)
+{
+  for (int32_t i = 0; i < len; i++) {
+    uint8_t c = s[i];
+    if (c < 0x80) {
+      *dst++ = c;
+    } else {
+      *dst++ = 0xC0 | (c >> 6);
+      *dst++ = 0x80 | (c & 0x3F);
+    }
+  }
+}
+
+bool
+rt_stringtoutf8(struct java_lang_String *s, char **out, int32_t *outlen)
+{
+  if (s->coder == CODER_LATIN1) {
+    int32_t reqsize = latin1utf8len(s->chars.latin1, s->len);
+    char *buffer = malloc(reqsize);
+    if (reqsize == s->len) {
+      memcpy(buffer, s->chars.latin1, reqsize);
+    } else {
+      latin1toutf8(buffer, s->chars.latin1, s->len);
+    }
+    *out = buffer;
+    *outlen = reqsize;
+    return true;
+  } else {
+    return utf16toutf8(s->chars.utf16, s->len, out, outlen);
+  }
+}
+
+struct java_lang_String*
+rt_makestring(struct utf8str *s)
+{
+  int32_t len;
+  UChar *buffer;
+  if (!utf8toutf16(s->bytes, s->len, &buffer, &len)) return NULL;
+  return rt_stringcreate(buffer, len);
+}
+
+/* String Interning
+ *
+ * Interned strings live in an open addressing table keyed on their UTF-8
+ * bytes. String literals are looked up by the bytes GenLLVM emits for them so
+ * each literal is transcoded and allocated only once. Interned strings are
+ * immortal; the runtime is single threaded so the table is not locked. */
+
+struct internentry {
+  uint32_t hash;
+  int32_t len;
+  const char *bytes;
+  struct java_lang_String *str;
+};
+
+static struct internentry *interntable = NULL;
+static uint32_t interncap = 0;
+static uint32_t interncount = 0;
+
+#define INTERN_INITCAP 1024
+
+static uint32_t
+hashutf8(const char *bytes, int32_t len)
+{
+  /* FNV-1a */
+  uint32_t h = 2166136261u;
+  for (int32_t i = 0; i < len; i++) {
+    h ^= (uint8_t)bytes[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+static struct internentry*
+internslot(struct internentry *table, uint32_t cap, const char *bytes, int32_t len, uint32_t hash)
+{
+  uint32_t i = hash & (cap - 1);
+  while (table[i].str != NULL) {
+    if (table[i].hash == hash && table[i].len == len &&
+        memcmp(table[i].bytes, bytes, len) == 0) {
+      break;
+    }
+    i = (i + 1) & (cap - 1);
+  }
+  return &table[i];
+}
+
+static void
+interngrow()
+{
+  uint32_t newcap = interncap == 0 ? INTERN_INITCAP : interncap * 2;
+  struct internentry *newtable = calloc(newcap, sizeof(struct internentry));
+  if (newtable == NULL) {
+    fprintf(stderr, "Out of memory growing intern table\n");
+    abort();
+  }
+  for (uint32_t i = 0; i < interncap; i++) {
+    struct internentry *e = &interntable[i];
+    if (e->str != NULL) {
+      *internslot(newtable, newcap, e->bytes, e->len, e->hash) = *e;
+    }
+  }
+  free(interntable);
+  interntable = newtable;
+  interncap = newcap;
+}
+
+static struct internentry*
+internlookup(const char *bytes, int32_t len, uint32_t hash)
+{
+  if ((interncount + 1) * 4 > interncap * 3) {
+    interngrow();
   }
+  return internslot(interntable, interncap, bytes, len, hash);
+}
+
+static void
+interninsert(struct internentry *slot, const char *bytes, int32_t len, uint32_t hash, struct java_lang_String *str)
+{
+  slot->hash = hash;
+  slot->len = len;
+  slot->bytes = bytes;
+  slot->str = str;
+  interncount++;
+}
+
+/* the interned string for a literal; its bytes must be constant for the
+ * life of the program, as the literals GenLLVM emits are */
+struct java_lang_String*
+rt_makeliteral(struct utf8str *s)
+{
+  uint32_t hash = hashutf8(s->bytes, s->len);
+  struct internentry *slot = internlookup(s->bytes, s->len, hash);
+  if (slot->str == NULL) {
+    struct java_lang_String *ret;
+    if (COMPACT_STRINGS && isascii7(s->bytes, s->len)) {
+      /* ASCII is already Latin-1, so the literal can be used in place */
+      union stringchars chars;
+      chars.latin1 = (uint8_t*)s->bytes;
+      ret = (struct java_lang_String*)rt_new_immortal(&class_java_Dlang_DString);
+      stringinit(ret, CODER_LATIN1, chars, s->len);
+    } else {
+      int32_t len;
+      UChar *buffer;
+      if (!utf8toutf16(s->bytes, s->len, &buffer, &len)) return NULL;
+      ret = (struct java_lang_String*)rt_new_immortal(&class_java_Dlang_DString);
+      stringinitutf16(ret, buffer, len);
+    }
+    interninsert(slot, s->bytes, s->len, hash, ret);
+  }
+  return slot->str;
+}
+
+struct java_lang_String*
+rt_internstring(struct java_lang_String *s)
+{
+  int32_t len;
+  char *bytes;
+  if (!rt_stringtoutf8(s, &bytes, &len)) return s;
+  uint32_t hash = hashutf8(bytes, len);
+  struct internentry *slot = internlookup(bytes, len, hash);
+  if (slot->str == NULL) {
+    /* character data is never freed so the immortal copy can share it */
+    struct java_lang_String *ret = (struct java_lang_String*)rt_new_immortal(&class_java_Dlang_DString);
+    interninsert(slot, bytes, len, hash, stringinit(ret, s->coder, s->chars, s->len));
+  } else {
+    free(bytes);
+  }
+  return slot->str;
+}
+
+struct java_lang_Object*
+method_java_Dlang_DString_Mintern_Rjava_Dlang_DString(struct java_lang_Object *self, vtable_t selfVtable,
+    vtable_t *vtableOut)
+{
+  struct java_lang_Object *ret = (struct java_lang_Object*)rt_internstring((struct java_lang_String*)self);
+  *vtableOut = rt_loadvtable(ret);
+  return ret;
 }
 
 void rt_string_append_Boolean(
@@ -91,20 +379,13 @@ void rt_string_append_Boolean(
   struct stringlist *n = malloc(sizeof(struct stringlist));
   n->prev = *s;
   *s = n;
+  n->coder = CODER_LATIN1;
   if (v) {
-    if (!u_TRUE_initted) {
-      U_STRING_INIT(u_TRUE_s, "true", 4);
-      u_TRUE_initted = true;
-    }
     n->len = 4;
-    n->s = u_TRUE_s;
+    n->chars.latin1 = l_TRUE_s;
   } else {
-    if (!u_FALSE_initted) {
-      U_STRING_INIT(u_FALSE_s, "false", 5);
-      u_FALSE_initted = true;
-    }
-    n->len = 4;
-    n->s = u_FALSE_s;
+    n->len = 5;
+    n->chars.latin1 = l_FALSE_s;
   }
 }
 
@@ -308,7 +589,8 @@ void rt_string_append_number(
   buffer = ustring_for_int(v, initsize, &len);
   if (buffer) {
     n->len = len;
-    n->s = buffer;
+    n->coder = CODER_UTF16;
+    n->chars.utf16 = buffer;
   } else {
     *s = n->prev;
     free(n);
@@ -337,14 +619,22 @@ void rt_string_append_Char(
   struct stringlist *n = malloc(sizeof(struct stringlist));
   n->prev = *s;
   *s = n;
+  if (COMPACT_STRINGS && v <= 0xFF) {
+    n->coder = CODER_LATIN1;
+    n->chars.latin1 = malloc(1);
+    n->chars.latin1[0] = v;
+    n->len = 1;
+    return;
+  }
+  n->coder = CODER_UTF16;
   if (U_IS_BMP(v)) {
-    n->s = malloc(sizeof(UChar));
+    n->chars.utf16 = malloc(sizeof(UChar));
     n->len = 1;
   } else {
-    n->s = malloc(sizeof(UChar)*2);
+    n->chars.utf16 = malloc(sizeof(UChar)*2);
     n->len = 2;
   }
-  U16_APPEND_UNSAFE(n->s, i, v);
+  U16_APPEND_UNSAFE(n->chars.utf16, i, v);
 }
 
 void rt_string_append_Int(
@@ -376,7 +666,8 @@ void rt_string_append_Long(
     }
     if (U_SUCCESS(err)) {
       n->len = reqsize;
-      n->s = buffer;
+      n->coder = CODER_UTF16;
+      n->chars.utf16 = buffer;
     } else {
       *s = n->prev;
     }
@@ -405,7 +696,8 @@ void rt_string_append_Double(
     }
     if (U_SUCCESS(err)) {
       n->len = reqsize;
-      n->s = buffer;
+      n->coder = CODER_UTF16;
+      n->chars.utf16 = buffer;
     } else {
       *s = n->prev;
     }
@@ -445,7 +737,8 @@ void rt_string_append_string(
   ss = (struct java_lang_String*)toString(sobj, rt_loadvtable(sobj), &tempVtable);
 
   n->len = ss->len;
-  n->s = ss->s;
+  n->coder = ss->coder;
+  n->chars = ss->chars;
 }
 
 void rt_string_append_ustring(
@@ -456,7 +749,8 @@ void rt_string_append_ustring(
   struct stringlist *n = malloc(sizeof(struct stringlist));
   n->prev = *s;
   n->len = len;
-  n->s = buffer;
+  n->coder = CODER_UTF16;
+  n->chars.utf16 = buffer;
   *s = n;
 }
 
@@ -464,8 +758,15 @@ int32_t method_java_Dlang_DString_MhashCode_Rscala_DInt(struct java_lang_Object
 {
   struct java_lang_String *self = (struct java_lang_String*)s;
   int32_t hashcode = 0;
-  for (int32_t i = 0; i < self->len; i++) {
-    hashcode += self->s[i] * 13;
+  /* must agree across coders, since equal strings may be stored either way */
+  if (self->coder == CODER_LATIN1) {
+    for (int32_t i = 0; i < self->len; i++) {
+      hashcode += self->chars.latin1[i] * 13;
+    }
+  } else {
+    for (int32_t i = 0; i < self->len; i++) {
+      hashcode += self->chars.utf16[i] * 13;
+    }
   }
   return hashcode;
 }
@@ -475,7 +776,18 @@ bool method_java_Dlang_DString_Mequals_Ajava_Dlang_DObject_Rscala_DBoolean(struc
   struct java_lang_String *self = (struct java_lang_String*)s;
   if (other && other->klass == &class_java_Dlang_DString) {
     struct java_lang_String *os = (struct java_lang_String*)other;
-    return 0 == u_strCompare(self->s, self->len, os->s, os->len, TRUE);
+    if (self->len != os->len) return false;
+    if (self->coder == os->coder) {
+      if (self->coder == CODER_LATIN1) {
+        return 0 == memcmp(self->chars.latin1, os->chars.latin1, self->len);
+      } else {
+        return 0 == u_memcmp(self->chars.utf16, os->chars.utf16, self->len);
+      }
+    }
+    for (int32_t i = 0; i < self->len; i++) {
+      if (rt_string_charat(self, i) != rt_string_charat(os, i)) return false;
+    }
+    return true;
   } else {
     return false;
   }
@@ -501,27 +813,47 @@ struct java_lang_String *
 rt_stringconcat(struct stringlist **s)
 {
   struct java_lang_String *ret = (struct java_lang_String*)rt_new(&class_java_Dlang_DString);
-  method_java_Dlang_DString_M_Linit_G_Rjava_Dlang_DString((struct java_lang_Object*)ret, rt_loadvtable((struct java_lang_Object*)ret));
-  UChar *buffer;
-  UChar *wp;
+  union stringchars chars;
+  bool latin1 = COMPACT_STRINGS;
   int32_t totlen = 0;
   struct stringlist *head = *s;
   while (head != NULL) {
     totlen += head->len;
+    if (latin1 && head->coder == CODER_UTF16 && !fitslatin1(head->chars.utf16, head->len)) {
+      latin1 = false;
+    }
     head = head->prev;
   }
-  buffer = malloc(totlen * sizeof(UChar));
-  wp = &buffer[totlen];
   head = *s;
-  while (head != NULL) {
-    //puts("x");
-    u_memcpy(wp - head->len, head->s, head->len);
-    wp -= head->len;
-    head = head->prev;
+  if (latin1) {
+    uint8_t *wp;
+    chars.latin1 = malloc(totlen);
+    wp = &chars.latin1[totlen];
+    while (head != NULL) {
+      wp -= head->len;
+      if (head->coder == CODER_LATIN1) {
+        memcpy(wp, head->chars.latin1, head->len);
+      } else {
+        narrowlatin1(wp, head->chars.utf16, head->len);
+      }
+      head = head->prev;
+    }
+    return stringinit(ret, CODER_LATIN1, chars, totlen);
+  } else {
+    UChar *wp;
+    chars.utf16 = malloc(totlen * sizeof(UChar));
+    wp = &chars.utf16[totlen];
+    while (head != NULL) {
+      wp -= head->len;
+      if (head->coder == CODER_LATIN1) {
+        widenlatin1(wp, head->chars.latin1, head->len);
+      } else {
+        u_memcpy(wp, head->chars.utf16, head->len);
+      }
+      head = head->prev;
+    }
+    return stringinit(ret, CODER_UTF16, chars, totlen);
   }
-  ret->len = totlen;
-  ret->s = buffer;
-  return ret;
 }
 
 struct java_lang_Object*
@@ -530,21 +862,20 @@ method__Ojava_Dlang_DString_Mutf8bytes_Ajava_Dlang_DString_R_Nscala_DByte(
     struct java_lang_String *s, vtable_t sVtable,
     vtable_t *vtableOut)
 {
-  enum UErrorCode uerr = U_ZERO_ERROR;
-  char *buffer;
-  int32_t bufsize = s->len;
   int32_t reqsize;
-  buffer = malloc(bufsize * sizeof(char));
-  u_strToUTF8(buffer, bufsize, &reqsize, s->s, s->len, &uerr);
-  if (uerr == U_BUFFER_OVERFLOW_ERROR) {
-    /* reallocate buffer and retry */
-    free(buffer);
-    buffer = malloc(reqsize * sizeof(char));
-    bufsize = reqsize;
-    uerr = U_ZERO_ERROR;
-    u_strToUTF8(buffer, bufsize, &reqsize, s->s, s->len, &uerr);
-  }
-  if (U_SUCCESS(uerr)) {
+  char *buffer;
+  if (s->coder == CODER_LATIN1) {
+    /* encode straight into the array; pure ASCII is a plain copy */
+    reqsize = latin1utf8len(s->chars.latin1, s->len);
+    struct array *ret = new_array(BYTE, NULL, 1, reqsize);
+    if (reqsize == s->len) {
+      memcpy(ARRAY_DATA(ret, char), s->chars.latin1, reqsize);
+    } else {
+      latin1toutf8(ARRAY_DATA(ret, char), s->chars.latin1, s->len);
+    }
+    *vtableOut = rt_loadvtable((struct java_lang_Object*)ret);
+    return (struct java_lang_Object*)ret;
+  } else if (utf16toutf8(s->chars.utf16, s->len, &buffer, &reqsize)) {
     struct array *ret = new_array(BYTE, NULL, 1, reqsize);
     memcpy(ARRAY_DATA(ret, char), buffer, reqsize);
     free(buffer);
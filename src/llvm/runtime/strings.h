@@ -12,17 +12,41 @@ extern struct klass class__Ojava_Dlang_DString;
 struct stringlist;
 
 
+/* With COMPACT_STRINGS strings whose characters all fit in Latin-1 are
+ * stored one byte per character; coder records which form chars holds. */
+#ifndef COMPACT_STRINGS
+#define COMPACT_STRINGS 1
+#endif
+
+#define CODER_LATIN1 0
+#define CODER_UTF16 1
+
+union stringchars {
+  uint8_t *latin1;
+  UChar *utf16;
+};
+
 struct java_lang_String {
   struct java_lang_Object super;
   int32_t len;
-  UChar *s;
+  int32_t coder;
+  union stringchars chars;
 };
 
+static inline UChar
+rt_string_charat(struct java_lang_String *s, int32_t i)
+{
+  return s->coder == CODER_LATIN1 ? s->chars.latin1[i] : s->chars.utf16[i];
+}
+
 struct _Ojava_lang_String {
   struct java_lang_Object super;
 };
 
 extern struct java_lang_String* rt_makestring(struct utf8str *s);
+extern struct java_lang_String* rt_makeliteral(struct utf8str *s);
+extern struct java_lang_String* rt_internstring(struct java_lang_String *s);
+extern bool rt_stringtoutf8(struct java_lang_String *s, char **out, int32_t *outlen);
 
 extern int32_t method_java_Dlang_DString_MhashCode_Rscala_DInt(struct java_lang_Object *self, vtable_t selfVtable);
 extern bool method_java_Dlang_DString_Mequals_Ajava_Dlang_DObject_Rscala_DBoolean(struct java_lang_Object*, vtable_t, struct java_lang_Object*, vtable_t);
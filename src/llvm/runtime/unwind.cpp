@@ -114,6 +114,13 @@ License End
 #include <stdint.h>
 #include <cstdlib>
 #include <cstring>
+#include <cstddef>
+#include <dlfcn.h>
+#include <pthread.h>
+
+extern "C" {
+#include "klass.h"
+}
 
 
 #ifndef USE_GLOBAL_STR_CONSTS
@@ -134,10 +141,18 @@ typedef struct _Unwind_Context* _Unwind_Context_t;
 ///       on a double word boundary. This is necessary to match the standard:
 ///       http://refspecs.freestandards.org/abi-eh-1.21.html
 ///
+#define OUR_TRACE_MAX 32
+
 struct OurBaseException_t
 {
     uint8_t *obj;
 
+    // Return addresses of the frames active when the exception was
+    // created, innermost first; see captureTrace
+    //
+    uint32_t traceDepth;
+    void *trace[OUR_TRACE_MAX];
+
     // Note: This is properly aligned in unwind.h
     //
     struct _Unwind_Exception unwindException;
@@ -153,7 +168,8 @@ typedef struct _Unwind_Exception OurUnwindException;
 // Various globals used to support typeinfo and generatted exceptions in general
 //
 
-int64_t baseFromUnwindOffset;
+int64_t baseFromUnwindOffset =
+    -(int64_t)offsetof(struct OurBaseException_t, unwindException);
 
 const unsigned char ourBaseExcpClassChars[] = 
                                 {'e', 'p', 'f', 'l', 's', 'c', 'a', 'l'};
@@ -161,6 +177,112 @@ const unsigned char ourBaseExcpClassChars[] =
 
 static uint64_t ourBaseExceptionClass = 0x4550464c7363616cLL;
 
+/// Scala functions the JIT has emitted, by start address, so that trace
+/// entries can be named; see registerScalaFunction.
+///
+struct FunctionRange
+{
+    uintptr_t end;
+    std::string name;
+};
+
+static std::map<uintptr_t, FunctionRange> scalaFunctions;
+
+/// The JIT may emit functions on other threads than the one printing a trace.
+///
+static pthread_mutex_t scalaFunctionsLock = PTHREAD_MUTEX_INITIALIZER;
+
+
+/// Whether an exception of obj's class records a stack trace. Control flow
+/// throwables (scala.util.control.ControlThrowable) and those mixing in
+/// scala.util.control.NoStackTrace are thrown for their effect only.
+/// @param obj thrown Scala object
+///
+static bool wantsTrace(uint8_t *obj)
+{
+    static const char *untraced[] = {
+        "scala.util.control.ControlThrowable",
+        "scala.util.control.NoStackTrace"
+    };
+
+    struct klass *klass = *(struct klass**) obj;
+
+    for (uint32_t i = 0; i < klass->numiface; ++i)
+    {
+        struct utf8str *name = &(klass->ifaces[i].klass->name);
+
+        for (size_t j = 0; j < sizeof(untraced) / sizeof(untraced[0]); ++j)
+        {
+            if (((size_t) name->len == strlen(untraced[j])) &&
+                (memcmp(name->bytes, untraced[j], name->len) == 0))
+            {
+                return(false);
+            }
+        }
+    }
+
+    return(true);
+}
+
+
+struct TraceState
+{
+    struct OurBaseException_t *excp;
+    int skip;
+};
+
+
+static _Unwind_Reason_Code traceFrame(_Unwind_Context_t context, void *arg)
+{
+    TraceState *state = (TraceState*) arg;
+
+    if (state->skip > 0)
+    {
+        state->skip--;
+        return(_URC_NO_REASON);
+    }
+
+    if (state->excp->traceDepth == OUR_TRACE_MAX)
+    {
+        return(_URC_END_OF_STACK);
+    }
+
+    uintptr_t ip = _Unwind_GetIP(context);
+
+    if (ip == 0)
+    {
+        return(_URC_END_OF_STACK);
+    }
+
+    state->excp->trace[state->excp->traceDepth++] = (void*) ip;
+
+    return(_URC_NO_REASON);
+}
+
+
+/// Records the return addresses of up to OUR_TRACE_MAX frames above the
+/// caller of createOurException. Only raw addresses are kept; they are
+/// turned into names when the trace is printed.
+/// @param excp exception to store the trace in
+///
+static void captureTrace(struct OurBaseException_t *excp)
+{
+    // Skip the frames of captureTrace and createOurException
+    //
+    TraceState state = { excp, 2 };
+
+    _Unwind_Backtrace(traceFrame, &state);
+}
+
+
+/// Deleted exceptions are kept on a short per-thread free list and reused
+/// by later throws, so once a thread has warmed up throwing does not touch
+/// the C heap unless more than ourExceptionPoolMax exceptions are in flight.
+///
+static const size_t ourExceptionPoolMax = 8;
+static __thread OurException* ourExceptionPool[ourExceptionPoolMax];
+static __thread size_t ourExceptionPoolSize = 0;
+
 extern "C" {
 /// Deletes the true previosly allocated exception whose address
 /// is calculated from the supplied OurBaseException_t::unwindException
@@ -178,7 +300,17 @@ void deleteOurException (OurUnwindException* expToDelete)
     {
         if (expToDelete->exception_class == ourBaseExceptionClass)
         {
-            free(((char*) expToDelete) + baseFromUnwindOffset);
+            OurException* excp = (OurException*)
+                            (((char*) expToDelete) + baseFromUnwindOffset);
+
+            if (ourExceptionPoolSize < ourExceptionPoolMax)
+            {
+                ourExceptionPool[ourExceptionPoolSize++] = excp;
+            }
+            else
+            {
+                free(excp);
+            }
         }
     }
 }
@@ -202,17 +334,34 @@ void deleteFromUnwindOurException (_Unwind_Reason_Code reason,
 }
 
 
-/// Creates (allocates on the heap), an exception (OurException instance),
-/// of the supplied type info type.
-/// @param type type info type
+/// Creates an exception (OurException instance), wrapping the supplied
+/// object, from the thread's pool or else the heap.
+/// @param obj the thrown Scala object
 ///
 OurUnwindException* createOurException (uint8_t *obj)
 {
     size_t size = sizeof(OurException);
 
-    OurException* ret = (OurException*) memset(malloc(size), 0, size);
+    OurException* ret;
+
+    if (ourExceptionPoolSize > 0)
+    {
+        ret = ourExceptionPool[--ourExceptionPoolSize];
+    }
+    else
+    {
+        ret = (OurException*) malloc(size);
+    }
+
+    memset(&(ret->unwindException), 0, sizeof(ret->unwindException));
 
     (ret->obj) = obj;
+    (ret->traceDepth) = 0;
+
+    if (wantsTrace(obj))
+    {
+        captureTrace(ret);
+    }
 
     (ret->unwindException).exception_class = ourBaseExceptionClass;
     (ret->unwindException).exception_cleanup = deleteFromUnwindOurException;
@@ -224,6 +373,141 @@ OurUnwindException* createOurException (uint8_t *obj)
 }
 
 
+/// Records where the JIT emitted a function, for naming trace entries.
+/// @param name function name
+/// @param start first byte of its code
+/// @param size size of its code
+///
+void registerScalaFunction (const char *name, void *start, size_t size)
+{
+    FunctionRange range;
+
+    range.end = (uintptr_t) start + size;
+    range.name = name;
+
+    pthread_mutex_lock(&scalaFunctionsLock);
+    scalaFunctions[(uintptr_t) start] = range;
+    pthread_mutex_unlock(&scalaFunctionsLock);
+}
+
+
+/// Forgets a function whose code the JIT has freed.
+/// @param start first byte of its code
+///
+void unregisterScalaFunction (void *start)
+{
+    pthread_mutex_lock(&scalaFunctionsLock);
+    scalaFunctions.erase((uintptr_t) start);
+    pthread_mutex_unlock(&scalaFunctionsLock);
+}
+
+
+/// Writes a mangled Scala method name such as
+/// method_java_Dlang_DString_MhashCode_Rscala_DInt as java.lang.String.hashCode;
+/// other names are written as they are.
+/// @param name symbol name
+/// @param out stream to write to
+///
+static void printScalaName (const char *name, FILE *out)
+{
+    const char *p;
+
+    if (strncmp(name, "method_", 7) != 0)
+    {
+        fputs(name, out);
+        return;
+    }
+
+    for (p = name + 7; *p; ++p)
+    {
+        if (*p != '_')
+        {
+            fputc(*p, out);
+            continue;
+        }
+
+        switch (*++p)
+        {
+            case '_': fputc('_', out); break;
+            case 'D': fputc('.', out); break;
+            case 'L': fputc('<', out); break;
+            case 'G': fputc('>', out); break;
+            case 'S': fputc('$', out); break;
+            case 'M': fputc('.', out); break;
+            case 'O': break;
+            case 'U':
+                // Non-ASCII characters are written as their code
+                //
+                fprintf(out, "\\u%.4s", p + 1);
+                p += (strlen(p + 1) >= 4) ? 4 : strlen(p + 1);
+                break;
+            default:
+                // _A and _R start the signature
+                //
+                return;
+        }
+    }
+}
+
+
+/// Prints the stack trace recorded when an exception was created, one frame
+/// per line, naming each frame from the functions the JIT registered or,
+/// failing that, from the dynamic symbol table.
+/// @param uwx thrown _Unwind_Exception instance
+///
+void printExceptionTrace (OurUnwindException* uwx)
+{
+    if ((uwx == NULL) || (uwx->exception_class != ourBaseExceptionClass))
+    {
+        return;
+    }
+
+    struct OurBaseException_t* excp = (struct OurBaseException_t*)
+                                (((char*) uwx) + baseFromUnwindOffset);
+
+    pthread_mutex_lock(&scalaFunctionsLock);
+
+    for (uint32_t i = 0; i < excp->traceDepth; ++i)
+    {
+        // Return addresses point after the call; look up the call itself
+        //
+        uintptr_t pc = (uintptr_t) excp->trace[i] - 1;
+
+        std::map<uintptr_t, FunctionRange>::iterator it = 
+                                            scalaFunctions.upper_bound(pc);
+
+        fputs("\tat ", stderr);
+
+        if ((it != scalaFunctions.begin()) && (pc < (--it)->second.end))
+        {
+            printScalaName(it->second.name.c_str(), stderr);
+            fprintf(stderr, "+0x%lx\n", (unsigned long) (pc + 1 - it->first));
+            continue;
+        }
+
+        Dl_info info;
+
+        if (dladdr((void*) pc, &info) && info.dli_sname)
+        {
+            printScalaName(info.dli_sname, stderr);
+            fprintf(stderr, "+0x%lx\n", 
+                    (unsigned long) (pc + 1 - (uintptr_t) info.dli_saddr));
+        }
+        else
+        {
+            fprintf(stderr, "%p\n", excp->trace[i]);
+        }
+    }
+
+    pthread_mutex_unlock(&scalaFunctionsLock);
+
+    if (excp->traceDepth == OUR_TRACE_MAX)
+    {
+        fputs("\t...\n", stderr);
+    }
+}
+
+
 /// read a uleb128 encoded value and advance pointer 
 /// See Variable Length Data in: 
 /// @link http://dwarfstd.org/Dwarf3.pdf @unlink
@@ -385,9 +669,270 @@ static uintptr_t readEncodedPointer(const uint8_t** data, uint8_t encoding)
 }
 
 
+/// Returns the size of a value stored with the given pointer encoding, as
+/// needed to index the type info table, whose entries all share one encoding.
+/// @param encoding dwarf encoding type
+/// @returns size in bytes
+///
+static size_t encodingSize(uint8_t encoding)
+{
+    switch (encoding & 0x0F) 
+    {
+        case llvm::dwarf::DW_EH_PE_absptr:
+            return(sizeof(uintptr_t));
+        case llvm::dwarf::DW_EH_PE_udata2:
+        case llvm::dwarf::DW_EH_PE_sdata2:
+            return(2);
+        case llvm::dwarf::DW_EH_PE_udata4:
+        case llvm::dwarf::DW_EH_PE_sdata4:
+            return(4);
+        case llvm::dwarf::DW_EH_PE_udata8:
+        case llvm::dwarf::DW_EH_PE_sdata8:
+            return(8);
+        default:
+            /* not supported 
+             */
+            abort();
+    }
+}
+
+
+/// Tests whether obj is an instance of klass, which is a class or an
+/// interface; a NULL klass is a catch all. The personality routine lives in
+/// the launcher rather than in the bitcode runtime, so this reads the klass
+/// layout directly in the same way as rt_isinstance.
+/// @param obj thrown Scala object
+/// @param klass type info of a handler
+/// @returns whether the handler catches obj
+///
+static bool exceptionMatches(uint8_t *obj, struct klass *klass)
+{
+    if (klass == NULL)
+    {
+        return(true);
+    }
+
+    struct klass *sub = *(struct klass**) obj;
+
+    if (klass->instsize == 0)
+    {
+        // Note: ifaces lists every interface a class implements, including
+        //       those inherited from its superclasses
+        //
+        for (uint32_t i = 0; i < sub->numiface; ++i)
+        {
+            if (sub->ifaces[i].klass == klass)
+            {
+                return(true);
+            }
+        }
+
+        return(false);
+    }
+
+    if (sub->depth < klass->depth)
+    {
+        return(false);
+    }
+
+    if (klass->depth < DISPLAY_SIZE)
+    {
+        return(sub->display[klass->depth] == klass);
+    }
+
+    while (sub->depth > klass->depth)
+    {
+        sub = sub->super;
+    }
+
+    return(sub == klass);
+}
+
+
+/// One entry of a decoded call-site table. Offsets are relative to the
+/// function start; action points into the action table, or is NULL when the
+/// landing pad is for cleanup only.
+///
+struct CallSite
+{
+    uintptr_t start;
+    uintptr_t length;
+    uintptr_t landingPad;
+    const uint8_t* action;
+};
+
+
+/// The decoded LSDA of one function. Call sites without a landing pad are
+/// dropped and the rest are kept in address order, as emitted.
+///
+struct LsdaInfo
+{
+    uintptr_t funcStart;
+    const uint8_t* lsda;
+    const uint8_t* classInfo;
+    uint8_t ttypeEncoding;
+    std::vector<CallSite> callSites;
+    LsdaInfo* next;
+};
+
+
+/// Decoded LSDAs are cached in a hash keyed on function start and LSDA
+/// address, so each table is parsed the first time a frame of its function
+/// is unwound. Buckets are lists that are only ever prepended to, with a
+/// compare and swap, so lookups take no lock.
+///
+static const size_t lsdaCacheSize = 1024;
+static LsdaInfo* lsdaCache[lsdaCacheSize];
+
+
+/// Parses the LSDA header and call-site table of a function.
+/// See @link http://refspecs.freestandards.org/abi-eh-1.21.html @unlink
+/// @param funcStart start of the function's code
+/// @param lsda language specific data area
+/// @returns the decoded tables
+///
+static LsdaInfo* parseLsda(uintptr_t funcStart, const uint8_t* lsda)
+{
+    LsdaInfo* info = new LsdaInfo();
+
+    info->funcStart = funcStart;
+    info->lsda = lsda;
+    info->classInfo = NULL;
+    info->next = NULL;
+
+    //
+    // Note: See JITDwarfEmitter::EmitExceptionTable(...) for corresponding
+    //       dwarf emittion
+    //
+
+    /* Parse LSDA header. */
+    //
+    uint8_t lpStartEncoding = *lsda++;
+
+    if (lpStartEncoding != llvm::dwarf::DW_EH_PE_omit) 
+    {
+        readEncodedPointer(&lsda, lpStartEncoding); 
+    }
+
+    info->ttypeEncoding = *lsda++;
+
+    if (info->ttypeEncoding != llvm::dwarf::DW_EH_PE_omit) 
+    {
+        // Calculate type info locations in emitted dwarf code which
+        // were flagged by type info arguments to llvm.eh.selector
+        // intrinsic
+        //
+        uintptr_t classInfoOffset = readULEB128(&lsda);
+        info->classInfo = lsda + classInfoOffset;
+    }
+
+    uint8_t         callSiteEncoding = *lsda++;
+    uint32_t        callSiteTableLength = readULEB128(&lsda);
+    const uint8_t*  callSiteTableStart = lsda;
+    const uint8_t*  callSiteTableEnd = callSiteTableStart + 
+                                                    callSiteTableLength;
+    const uint8_t*  actionTableStart = callSiteTableEnd;
+
+    const uint8_t*  callSitePtr = callSiteTableStart;
+
+    while (callSitePtr < callSiteTableEnd) 
+    {
+        CallSite site;
+
+        site.start = readEncodedPointer(&callSitePtr, callSiteEncoding);
+        site.length = readEncodedPointer(&callSitePtr, callSiteEncoding);
+        site.landingPad = readEncodedPointer(&callSitePtr, callSiteEncoding);
+
+        // Note: Action value
+        //
+        uintptr_t actionEntry = readULEB128(&callSitePtr);
+
+        site.action = actionEntry ? actionTableStart + actionEntry - 1 : NULL;
+
+        if (site.landingPad != 0)
+        {
+            info->callSites.push_back(site);
+        }
+    }
+
+    return(info);
+}
+
+
+/// Finds the decoded LSDA of a function, parsing and caching it on first use.
+/// @param funcStart start of the function's code
+/// @param lsda language specific data area
+/// @returns the decoded tables
+///
+static LsdaInfo* lookupLsda(uintptr_t funcStart, const uint8_t* lsda)
+{
+    size_t bucket = ((funcStart ^ (uintptr_t) lsda) >> 4) % lsdaCacheSize;
+
+    for (LsdaInfo* info = lsdaCache[bucket]; info != NULL; info = info->next)
+    {
+        if ((info->funcStart == funcStart) && (info->lsda == lsda))
+        {
+            return(info);
+        }
+    }
+
+    LsdaInfo* info = parseLsda(funcStart, lsda);
+
+    do
+    {
+        info->next = lsdaCache[bucket];
+    }
+    while (!__sync_bool_compare_and_swap(&lsdaCache[bucket], info->next, info));
+
+    return(info);
+}
+
+
+/// Binary searches a function's call sites for the one covering pcOffset.
+/// @param info decoded LSDA of the function
+/// @param pcOffset offset of the throwing instruction from the function start
+/// @returns the call site, or NULL if the instruction has no landing pad
+///
+static const CallSite* findCallSite(const LsdaInfo* info, uintptr_t pcOffset)
+{
+    size_t lo = 0,
+           hi = info->callSites.size();
+
+    // Find the last call site starting at or before pcOffset
+    //
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (info->callSites[mid].start <= pcOffset)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    if (lo == 0)
+    {
+        return(NULL);
+    }
+
+    const CallSite* site = &info->callSites[lo - 1];
+
+    if (pcOffset < site->start + site->length)
+    {
+        return(site);
+    }
+
+    return(NULL);
+}
+
+
 /// Functionality which deals with Dwarf actions matching our 
-/// type infos (OurExceptionType_t instances). Returns whether or
-/// not a dwarf emitted action matches the supplied exception type.
+/// type infos (klass pointers). Returns whether or
+/// not a dwarf emitted action matches the supplied exception's class.
 /// If such a match succeeds, the resultAction argument will be set
 /// with > 0 index value. Only corresponding llvm.eh.selector type info
 /// arguments, cleanup arguments are supported. Filters are not supported.
@@ -395,9 +940,8 @@ static uintptr_t readEncodedPointer(const uint8_t** data, uint8_t encoding)
 /// @link http://dwarfstd.org/Dwarf3.pdf @unlink
 /// Also see @link http://refspecs.freestandards.org/abi-eh-1.21.html @unlink
 /// @param resultAction reference variable which will be set with result
-/// @param classInfo our array of type info pointers (to globals)
-/// @param actionEntry index into above type info array or 0 (clean up). 
-///        We do not support filters.
+/// @param info decoded LSDA holding the type info table
+/// @param actionPos first action record of the call site
 /// @param exceptionClass exception class (_Unwind_Exception::exception_class)
 ///        of thrown exception.
 /// @param exceptionObject thrown _Unwind_Exception instance.
@@ -405,8 +949,8 @@ static uintptr_t readEncodedPointer(const uint8_t** data, uint8_t encoding)
 ///          a cleanup was found
 ///
 static bool handleActionValue (int64_t *resultAction,
-                               struct OurExceptionType_t **classInfo, 
-                               uintptr_t actionEntry, 
+                               const LsdaInfo *info,
+                               const uint8_t *actionPos,
                                uint64_t exceptionClass, 
                                struct _Unwind_Exception *exceptionObject)
 {
@@ -429,8 +973,7 @@ static bool handleActionValue (int64_t *resultAction,
                 excp);
 #endif
 
-        const uint8_t *actionPos = (uint8_t*) actionEntry,
-                      *tempActionPos;
+        const uint8_t *tempActionPos;
 
         int64_t typeOffset = 0,
                 actionOffset;
@@ -457,37 +1000,42 @@ static bool handleActionValue (int64_t *resultAction,
                    "handleActionValue(...):filters are not supported.");
 
             // Note: A typeOffset == 0 implies that a cleanup llvm.eh.selector
-            //       argument has been matched.
+            //       argument has been matched. Type info entries are stored
+            //       backwards from classInfo.
             //
-            // TODO: check classes here
-            if ((typeOffset > 0)/* &&
-                (type == (classInfo[-typeOffset])->type)*/)
+            if (typeOffset > 0)
             {
+                const uint8_t *entry = info->classInfo - 
+                              typeOffset * encodingSize(info->ttypeEncoding);
+                struct klass *klass = (struct klass*) 
+                              readEncodedPointer(&entry, info->ttypeEncoding);
+
+                if (exceptionMatches(obj, klass))
+                {
 #ifdef DEBUG
-                fprintf(stderr,
-                        "handleActionValue(...):actionValue <%d> found.\n",
-                        i);
+                    fprintf(stderr,
+                            "handleActionValue(...):actionValue <%d> found.\n",
+                            i);
 #endif
 
-                *resultAction = i + 1;
-                ret = true;
-                break;
+                    *resultAction = i + 1;
+                    ret = true;
+                    break;
+                }
             }
-            else
-            {
+
 #ifdef DEBUG
-                fprintf(stderr,
-                        "handleActionValue(...):actionValue not found.\n");
+            fprintf(stderr,
+                    "handleActionValue(...):actionValue not found.\n");
 #endif
 
-                if (actionOffset)
-                {
-                    actionPos += actionOffset;
-                }
-                else
-                {
-                    break;
-                }
+            if (actionOffset)
+            {
+                actionPos += actionOffset;
+            }
+            else
+            {
+                break;
             }
         }
     }
@@ -520,219 +1068,118 @@ static _Unwind_Reason_Code handleLsda
 {
     _Unwind_Reason_Code ret = _URC_CONTINUE_UNWIND;
 
-    if (lsda)
+    if (!lsda)
     {
-#ifdef DEBUG
-        fprintf(stderr, 
-                "handleLsda(...):lsda is non-zero.\n");
-#endif
-
-        // Get the current instruction pointer and offset it before next
-        // instruction in the current frame which threw the exception.
-        //
-        uintptr_t pc = _Unwind_GetIP(context)-1;
-
-        // Get beginning current frame's code (as defined by the 
-        // emitted dwarf code)
-        //
-        uintptr_t funcStart = _Unwind_GetRegionStart(context);
-        uintptr_t pcOffset = pc - funcStart;
-
-        struct OurExceptionType_t** classInfo = NULL;
-
-        //
-        // Note: See JITDwarfEmitter::EmitExceptionTable(...) for corresponding
-        //       dwarf emittion
-        //
-
-        /* Parse LSDA header. */
-        //
-        uint8_t lpStartEncoding = *lsda++;
-
-        if (lpStartEncoding != llvm::dwarf::DW_EH_PE_omit) 
-        {
-            readEncodedPointer(&lsda, lpStartEncoding); 
-        }
-
-        uint8_t ttypeEncoding = *lsda++;
-        uintptr_t classInfoOffset;
-
-        if (ttypeEncoding != llvm::dwarf::DW_EH_PE_omit) 
-        {
-            // Calculate type info locations in emitted dwarf code which
-            // were flagged by type info arguments to llvm.eh.selector
-            // intrinsic
-            //
-            classInfoOffset = readULEB128(&lsda);
-            classInfo = (struct OurExceptionType_t**) (lsda + classInfoOffset);
-        }
-
-
-        /* Walk call-site table looking for range that 
-         * includes current PC. 
-         */
-        uint8_t         callSiteEncoding = *lsda++;
-        uint32_t        callSiteTableLength = readULEB128(&lsda);
-        const uint8_t*  callSiteTableStart = lsda;
-        const uint8_t*  callSiteTableEnd = callSiteTableStart + 
-                                                        callSiteTableLength;
-        const uint8_t*  actionTableStart = callSiteTableEnd;
-
-        const uint8_t*  callSitePtr = callSiteTableStart;
-
-        bool foreignException = false;
-
-
-        while (callSitePtr < callSiteTableEnd) 
-        {
-            uintptr_t start = readEncodedPointer(&callSitePtr, 
-                                                 callSiteEncoding);
-
-            uintptr_t length = readEncodedPointer(&callSitePtr, 
-                                                  callSiteEncoding);
+        return(ret);
+    }
 
-            uintptr_t landingPad = readEncodedPointer(&callSitePtr, 
-                                                      callSiteEncoding);
+    // Get the current instruction pointer and offset it before next
+    // instruction in the current frame which threw the exception.
+    //
+    uintptr_t pc = _Unwind_GetIP(context)-1;
 
-            // Note: Action value
-            //
-            uintptr_t actionEntry = readULEB128(&callSitePtr);
+    // Get beginning current frame's code (as defined by the 
+    // emitted dwarf code)
+    //
+    uintptr_t funcStart = _Unwind_GetRegionStart(context);
+    uintptr_t pcOffset = pc - funcStart;
 
-            if (exceptionClass != ourBaseExceptionClass)
-            {
-                // We have been notified of a foreign exception being thrown,
-                // and we therefore need to execute cleanup landing pads
-                //
-                actionEntry = 0;
-                foreignException = true;
-            }
+    const LsdaInfo* info = lookupLsda(funcStart, lsda);
+    const CallSite* site = findCallSite(info, pcOffset);
 
-            if (landingPad == 0)
-            {
+    if (site == NULL)
+    {
 #ifdef DEBUG
-                fprintf(stderr,
-                        "handleLsda(...): No landing pad found.\n");
+        fprintf(stderr,
+                "handleLsda(...): No landing pad found.\n");
 #endif
 
-                continue; /* no landing pad for this entry */
-            }
+        return(ret);
+    }
 
-            if (actionEntry)
-            {
-                actionEntry += ((uintptr_t) actionTableStart) - 1;
-            }
-            else
-            {
 #ifdef DEBUG
-                fprintf(stderr,
-                        "handleLsda(...):No action table found.\n");
+    fprintf(stderr,
+            "handleLsda(...): Landing pad found.\n");
 #endif
-            }
 
-            bool exceptionMatched = false;
-
-            if ((start <= pcOffset) && (pcOffset < (start + length))) 
-            {
-#ifdef DEBUG
-                fprintf(stderr,
-                        "handleLsda(...): Landing pad found.\n");
-#endif
+    // We have been notified of a foreign exception being thrown,
+    // and we therefore need to execute cleanup landing pads
+    //
+    const uint8_t* action = (exceptionClass == ourBaseExceptionClass) ?
+                                                        site->action : NULL;
 
-                int64_t actionValue = 0;
+    int64_t actionValue = 0;
+    bool exceptionMatched = false;
 
-                if (actionEntry)
-                {
-                    exceptionMatched = handleActionValue
-                                       (
-                                           &actionValue,
-                                           classInfo, 
-                                           actionEntry, 
-                                           exceptionClass, 
-                                           exceptionObject
-                                       );
-                }
+    if (action)
+    {
+        exceptionMatched = handleActionValue
+                           (
+                               &actionValue,
+                               info, 
+                               action, 
+                               exceptionClass, 
+                               exceptionObject
+                           );
+    }
 
-                if (!(actions & _UA_SEARCH_PHASE))
-                {
+    if (!(actions & _UA_SEARCH_PHASE))
+    {
 #ifdef DEBUG
-                    fprintf(stderr,
-                            "handleLsda(...): installed landing pad "
-                                "context.\n");
+        fprintf(stderr,
+                "handleLsda(...): installed landing pad "
+                    "context.\n");
 #endif
 
-                    /* Found landing pad for the PC.
-                     * Set Instruction Pointer to so we re-enter function 
-                     * at landing pad. The landing pad is created by the 
-                     * compiler to take two parameters in registers.
-                     */
-                    _Unwind_SetGR(context, 
-                                  __builtin_eh_return_data_regno(0), 
-                                  (uintptr_t)exceptionObject);
-
-                    // Note: this virtual register directly corresponds
-                    //       to the return of the llvm.eh.selector intrinsic
-                    //
-                    if (!actionEntry || !exceptionMatched)
-                    {
-                        // We indicate cleanup only
-                        //
-                        _Unwind_SetGR(context, 
-                                      __builtin_eh_return_data_regno(1), 
-                                      0);
-                    }
-                    else
-                    {
-                        // Matched type info index of llvm.eh.selector intrinsic
-                        // passed here.
-                        //
-                        _Unwind_SetGR(context, 
-                                      __builtin_eh_return_data_regno(1), 
-                                      actionValue);
-                    }
-
-                    // To execute landing pad set here
-                    //
-                    _Unwind_SetIP(context, funcStart + landingPad);
-
-                    ret = _URC_INSTALL_CONTEXT;
+        /* Found landing pad for the PC.
+         * Set Instruction Pointer to so we re-enter function 
+         * at landing pad. The landing pad is created by the 
+         * compiler to take two parameters in registers.
+         */
+        _Unwind_SetGR(context, 
+                      __builtin_eh_return_data_regno(0), 
+                      (uintptr_t)exceptionObject);
 
-                    break;
-                }
-                else
-                {
-                    if (exceptionMatched)
-                    {
+        // Note: this virtual register directly corresponds
+        //       to the return of the llvm.eh.selector intrinsic;
+        //       zero indicates cleanup only
+        //
+        _Unwind_SetGR(context, 
+                      __builtin_eh_return_data_regno(1), 
+                      exceptionMatched ? actionValue : 0);
+
+        // To execute landing pad set here
+        //
+        _Unwind_SetIP(context, funcStart + site->landingPad);
+
+        ret = _URC_INSTALL_CONTEXT;
+    }
+    else if (exceptionMatched)
+    {
 #ifdef DEBUG
-                        fprintf(stderr,
-                                "handleLsda(...): setting handler found.\n");
+        fprintf(stderr,
+                "handleLsda(...): setting handler found.\n");
 #endif
 
-                        ret = _URC_HANDLER_FOUND;
-                    }
-                    else
-                    {
-                        //
-                        // Note: Only non-clean up handlers are marked as
-                        //       found. Otherwise the clean up handlers will be 
-                        //       re-found and executed during the clean up 
-                        //       phase.
-                        //
+        ret = _URC_HANDLER_FOUND;
+    }
+    else
+    {
+        //
+        // Note: Only non-clean up handlers are marked as
+        //       found. Otherwise the clean up handlers will be 
+        //       re-found and executed during the clean up 
+        //       phase.
+        //
 #ifdef DEBUG
-                        fprintf(stderr,
-                                "handleLsda(...): cleanup handler found.\n");
+        fprintf(stderr,
+                "handleLsda(...): cleanup handler found.\n");
 #endif
-                    }
-
-                    break;
-                }
-            }
-        }
     }
 
     return(ret);
 }
 
-
 /// This is the personality function which is embedded (dwarf emitted), in the
 /// dwarf unwind info block. Again see: JITDwarfEmitter.cpp.
 /// See @link http://refspecs.freestandards.org/abi-eh-1.21.html @unlink
@@ -808,13 +1255,6 @@ uint8_t *getExceptionObject(_Unwind_Exception *uwx)
 #ifdef DEBUG
   fprintf(stderr, "getExceptionObject uwx = %p\n", uwx);
 #endif
-  struct OurBaseException_t dummyException;
-
-  // Calculate offset of OurException::unwindException member.
-  //
-  baseFromUnwindOffset = ((uintptr_t) &dummyException) - 
-    ((uintptr_t) &(dummyException.unwindException));
-
   struct OurBaseException_t* excp = (struct OurBaseException_t*)
     (((char*) uwx) + baseFromUnwindOffset);
   return excp->obj;
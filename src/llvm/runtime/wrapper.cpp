@@ -1,8 +1,13 @@
 #include "wrapper.h"
 
 #include "llvm/Function.h"
+#include "llvm/PassManager.h"
 #include "llvm/Support/IRBuilder.h"
 #include "llvm/Intrinsics.h"
+#include "llvm/Linker.h"
+#include "llvm/Target/TargetData.h"
+#include "llvm/Transforms/IPO.h"
+#include "llvm/Transforms/Scalar.h"
 
 using namespace llvm;
 
@@ -102,8 +107,104 @@ createMainWrapperFunction(
       builder.CreateCall(
         module.getFunction("getExceptionObject"),
         uwx));
+  builder.CreateCall(
+      module.getOrInsertFunction("printExceptionTrace",
+        builder.getVoidTy(), builder.getInt8Ty()->getPointerTo(), NULL),
+      uwx);
   builder.CreateRetVoid();
 
   return ret;
 }
 
+void addMainWrapperExports(std::vector<const char*> &exports)
+{
+  exports.push_back("rt_loadvtable");
+  exports.push_back("rt_argvtoarray");
+  exports.push_back("rt_printexception");
+  exports.push_back("class_java_Dlang_DThrowable");
+}
+
+/* Only the archive members the program needs are linked, so this does
+ * nothing for programs already linked against the runtime. */
+bool linkRuntime(Module *m, const std::string &archive, std::string *err)
+{
+  Linker linker("scala", m);
+  bool isNative;
+  if (linker.LinkInArchive(sys::Path(archive), isNative)) {
+    *err = linker.getLastError();
+    linker.releaseModule();
+    return false;
+  }
+  linker.releaseModule();
+  return true;
+}
+
+void addFunctionPasses(FunctionPassManager &fpm, unsigned level, const TargetData *td)
+{
+  fpm.add(new TargetData(*td));
+  fpm.add(createPromoteMemoryToRegisterPass());
+  fpm.add(createInstructionCombiningPass());
+  fpm.add(createCFGSimplificationPass());
+  if (level >= 2) {
+    if (level >= 3) fpm.add(createScalarReplAggregatesPass());
+    fpm.add(createReassociatePass());
+    fpm.add(createGVNPass());
+    fpm.add(createLICMPass());
+    if (level >= 3) fpm.add(createLoopUnswitchPass());
+    fpm.add(createInstructionCombiningPass());
+    fpm.add(createDeadStoreEliminationPass());
+    fpm.add(createCFGSimplificationPass());
+  }
+}
+
+/* The per-function pipeline run over the whole program before any of it
+ * is compiled; level 0 runs nothing. Inlining needs the call graph, so it
+ * runs first, over the module.
+ *
+ * For whole-program optimization everything but exports becomes internal,
+ * so small runtime helpers are inlined into the generated code at every
+ * level and their out-of-line copies deleted. */
+void optimizeModule(Module &m, unsigned level, const TargetData *td,
+                    const std::vector<const char*> *exports)
+{
+  if (exports) {
+    PassManager mpm;
+    mpm.add(new TargetData(*td));
+    mpm.add(createInternalizePass(*exports));
+    mpm.add(createIPSCCPPass());
+    mpm.add(createGlobalOptimizerPass());
+    mpm.add(createGlobalDCEPass());
+    mpm.add(createFunctionInliningPass(level >= 3 ? 275 : 225));
+    mpm.add(createGlobalDCEPass());
+    mpm.run(m);
+  }
+
+  if (level == 0) return;
+
+  if (level >= 2 && !exports) {
+    PassManager mpm;
+    mpm.add(new TargetData(*td));
+    mpm.add(createFunctionInliningPass(level >= 3 ? 275 : 225));
+    mpm.run(m);
+  }
+
+  FunctionPassManager fpm(&m);
+  addFunctionPasses(fpm, level, td);
+  fpm.doInitialization();
+  for (Module::iterator it = m.begin(); it != m.end(); ++it) {
+    if (!it->isDeclaration()) fpm.run(*it);
+  }
+  fpm.doFinalization();
+}
+
+const char optimizeBuildId[] = __DATE__ " " __TIME__;
+
+CodeGenOpt::Level codeGenOptLevel(unsigned level)
+{
+  switch (level) {
+    case 0: return CodeGenOpt::None;
+    case 1: return CodeGenOpt::Less;
+    case 2: return CodeGenOpt::Default;
+    default: return CodeGenOpt::Aggressive;
+  }
+}
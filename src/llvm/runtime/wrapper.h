@@ -1,8 +1,12 @@
 #include <string>
+#include <vector>
 #include "llvm/Module.h"
+#include "llvm/Target/TargetMachine.h"
 
 class llvm::Function;
 class llvm::GlobalVariable;
+class llvm::FunctionPassManager;
+class llvm::TargetData;
 
 std::string encodeName(const std::string &s);
 
@@ -13,3 +17,19 @@ createMainWrapperFunction(
     llvm::GlobalVariable *moduleGlobal,
     llvm::Function *modInitFn,
     const char *name);
+
+/* the symbols a main wrapper uses, for whole-program optimization */
+void addMainWrapperExports(std::vector<const char*> &exports);
+
+/* links the runtime's bitcode archive into the program */
+bool linkRuntime(llvm::Module *m, const std::string &archive, std::string *err);
+
+/* the optimization pipeline shared by runscala and linkscala; with
+ * exports, everything else is made internal to the program first */
+void addFunctionPasses(llvm::FunctionPassManager &fpm, unsigned level, const llvm::TargetData *td);
+void optimizeModule(llvm::Module &m, unsigned level, const llvm::TargetData *td,
+                    const std::vector<const char*> *exports = 0);
+llvm::CodeGenOpt::Level codeGenOptLevel(unsigned level);
+
+/* differs between builds of the pipeline, for keying caches of its output */
+extern const char optimizeBuildId[];